@@ -0,0 +1,267 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+
+// Incrementally updated attack maps. A slider's attacks can only change if
+// one of the squares whose occupancy changed is in them: either it was the
+// first blocker on a ray and has gone, or it was empty and in reach and is
+// now in the way. So the sliders to look up again are just those whose
+// attacks take in one of those squares, plus any slider that arrived or
+// left; there are rarely more than a dozen sliders to check. Their old
+// attacks go on a stack, so taking a move back is a copy, not a lookup.
+
+namespace AttackMap {
+
+static enum BBSquareKind Kind(const BBAttackMap* map, const unsigned int sq)
+{
+    const uint64_t bit = 1ULL << sq;
+
+    if (map->Bishops & map->Rooks & bit) {
+        return BBQueenSlider;
+    } else if (map->Bishops & bit) {
+        return BBBishopSlider;
+    } else if (map->Rooks & bit) {
+        return BBRookSlider;
+    } else if (map->Occupancy & bit) {
+        return BBNonSlider;
+    }
+
+    return BBEmptySquare;
+}
+
+static void Place(BBAttackMap* map, const unsigned int sq, const enum BBSquareKind kind)
+{
+    const uint64_t bit = 1ULL << sq;
+
+    map->Occupancy &= ~bit;
+    map->Bishops &= ~bit;
+    map->Rooks &= ~bit;
+
+    if (kind != BBEmptySquare) {
+        map->Occupancy |= bit;
+    }
+
+    if (kind == BBBishopSlider || kind == BBQueenSlider) {
+        map->Bishops |= bit;
+    }
+
+    if (kind == BBRookSlider || kind == BBQueenSlider) {
+        map->Rooks |= bit;
+    }
+}
+
+static uint64_t SliderAttacks(const BBAttackMap* map, const unsigned int sq)
+{
+    const uint64_t bit = 1ULL << sq;
+
+    if (map->Bishops & map->Rooks & bit) {
+        return BBAttackQueen(map->Occupancy, sq);
+    } else if (map->Bishops & bit) {
+        return BBAttackBishop(map->Occupancy, sq);
+    } else if (map->Rooks & bit) {
+        return BBAttackRook(map->Occupancy, sq);
+    }
+
+    return 0;
+}
+
+// The sliders whose attacks take in any of squares.
+static uint64_t Attackers(const BBAttackMap* map, const uint64_t squares)
+{
+    uint64_t sliders = map->Bishops | map->Rooks;
+    uint64_t attackers = 0;
+
+    while (sliders) {
+        const unsigned int sq = __builtin_ctzll(sliders);
+
+        attackers |= (uint64_t)((map->Attacks[sq] & squares) != 0) << sq;
+        sliders &= sliders - 1;
+    }
+
+    return attackers;
+}
+
+// Give the slider on sq (or nothing) its new attacks, and if the map keeps
+// attacks-to sets, fix up those of only the squares that changed, which are
+// the bits set in one or the other but not both.
+static void Retarget(BBAttackMap* map, const unsigned int sq, const uint64_t attacks)
+{
+    const uint64_t bit = 1ULL << sq;
+    uint64_t changed = attacks ^ map->Attacks[sq];
+
+    map->Attacks[sq] = attacks;
+
+    if (!(map->Flags & BBATTACK_MAP_ATTACKS_TO)) {
+        return;
+    }
+
+    while (changed) {
+        map->AttacksTo[__builtin_ctzll(changed)] ^= bit;
+        changed &= changed - 1;
+    }
+}
+
+// Put kind[i] on square[i] for n squares, and look up every slider that
+// might have been affected, keeping what Unmake() needs to put it all back.
+static void Apply(BBAttackMap* map, const int n, const unsigned int* square, const enum BBSquareKind* kind)
+{
+    assert(map->Ply < BBATTACK_MAP_DEPTH);
+
+    auto& undo = map->Undo[map->Ply++];
+    uint64_t changed = 0, touched = 0;
+    int i = 0;
+
+    undo.Occupancy = map->Occupancy;
+    undo.Bishops = map->Bishops;
+    undo.Rooks = map->Rooks;
+
+    for (i = 0; i < n; i++) {
+        const uint64_t bit = 1ULL << square[i];
+
+        if (((map->Occupancy & bit) != 0) != (kind[i] != BBEmptySquare)) {
+            changed |= bit;
+        }
+
+        touched |= bit;
+    }
+
+    // Sliders that saw a square change, or that left or arrived.
+    uint64_t affected = (map->Bishops | map->Rooks) & touched;
+
+    if (map->Flags & BBATTACK_MAP_ATTACKS_TO) {
+        for (uint64_t c = changed; c; c &= c - 1) {
+            affected |= map->AttacksTo[__builtin_ctzll(c)];
+        }
+    } else {
+        affected |= Attackers(map, changed);
+    }
+
+    for (i = 0; i < n; i++) {
+        Place(map, square[i], kind[i]);
+    }
+
+    affected |= (map->Bishops | map->Rooks) & touched;
+
+    // There are never more than 64 to save. If they mightn't fit, Unmake()
+    // looks them up again instead.
+    const bool save = map->SavedCount + 64 <= BBATTACK_MAP_SAVED;
+
+    undo.Affected = affected;
+    undo.Saved = save ? map->SavedCount : BBATTACK_MAP_SAVED;
+
+    while (affected) {
+        const unsigned int sq = __builtin_ctzll(affected);
+
+        if (save) {
+            map->Saved[map->SavedCount++] = map->Attacks[sq];
+        }
+
+        Retarget(map, sq, SliderAttacks(map, sq));
+        affected &= affected - 1;
+    }
+}
+}
+
+extern "C" {
+void BBAttackMapInit(BBAttackMap* map, const uint64_t occupancy, const uint64_t bishops, const uint64_t rooks, const unsigned int flags)
+{
+    uint64_t sliders = bishops | rooks;
+    int sq = 0;
+
+    map->Occupancy = occupancy;
+    map->Bishops = bishops;
+    map->Rooks = rooks;
+    map->Flags = flags;
+    map->Ply = 0;
+    map->SavedCount = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        map->Attacks[sq] = 0;
+        map->AttacksTo[sq] = 0;
+    }
+
+    while (sliders) {
+        sq = __builtin_ctzll(sliders);
+        AttackMap::Retarget(map, sq, AttackMap::SliderAttacks(map, sq));
+        sliders &= sliders - 1;
+    }
+}
+
+void BBAttackMapMakeMove(BBAttackMap* map, const unsigned int from, const unsigned int to)
+{
+    const unsigned int square[2] = { from, to };
+    const enum BBSquareKind kind[2] = { BBEmptySquare, AttackMap::Kind(map, from) };
+
+    AttackMap::Apply(map, 2, square, kind);
+}
+
+void BBAttackMapSet(BBAttackMap* map, const unsigned int square, const enum BBSquareKind kind)
+{
+    AttackMap::Apply(map, 1, &square, &kind);
+}
+
+void BBAttackMapUnmake(BBAttackMap* map)
+{
+    assert(map->Ply > 0);
+
+    const auto& undo = map->Undo[--map->Ply];
+    uint64_t affected = undo.Affected;
+    unsigned int next = undo.Saved;
+
+    map->Occupancy = undo.Occupancy;
+    map->Bishops = undo.Bishops;
+    map->Rooks = undo.Rooks;
+
+    while (affected) {
+        const unsigned int sq = __builtin_ctzll(affected);
+
+        if (undo.Saved != BBATTACK_MAP_SAVED) {
+            AttackMap::Retarget(map, sq, map->Saved[next++]);
+        } else {
+            AttackMap::Retarget(map, sq, AttackMap::SliderAttacks(map, sq));
+        }
+
+        affected &= affected - 1;
+    }
+
+    if (undo.Saved != BBATTACK_MAP_SAVED) {
+        map->SavedCount = undo.Saved;
+    }
+}
+
+uint64_t BBAttackMapAttacksTo(const BBAttackMap* map, const unsigned int square)
+{
+    if (map->Flags & BBATTACK_MAP_ATTACKS_TO) {
+        return map->AttacksTo[square];
+    }
+
+    return AttackMap::Attackers(map, 1ULL << square);
+}
+}
@@ -0,0 +1,151 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+// The vector helpers are always inlined into callers built for the right
+// instruction set, so warnings about the vector calling convention are moot.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#include "bbattack-private.h"
+
+#ifdef BBATTACK_X86_TARGETS
+
+// Kogge-Stone doesn't care how many sliders it fills from, nor whether the
+// bitboards come one at a time or a vector at a time. So put one position
+// in each 64-bit lane and run the very same fill: 4 positions per AVX2
+// register, 8 per AVX-512 register, and not a single table lookup.
+
+namespace Batch {
+
+typedef uint64_t U64x4 __attribute__((vector_size(32)));
+typedef uint64_t U64x8 __attribute__((vector_size(64)));
+
+enum Piece {
+    Bishop,
+    Rook,
+    Queen
+};
+
+template<Piece piece, typename V>
+__attribute__((always_inline)) inline V Fill(const V& empty, const V& fill)
+{
+    using KoggeStone::KoggeStone;
+
+    V attacks = {};
+
+    if (piece != Rook) {
+        attacks |= KoggeStone<Northeast>(empty, fill) |
+                   KoggeStone<Northwest>(empty, fill) |
+                   KoggeStone<Southeast>(empty, fill) |
+                   KoggeStone<Southwest>(empty, fill);
+    }
+
+    if (piece != Bishop) {
+        attacks |= KoggeStone<North>(empty, fill) |
+                   KoggeStone<South>(empty, fill) |
+                   KoggeStone<East >(empty, fill) |
+                   KoggeStone<West >(empty, fill);
+    }
+
+    return attacks;
+}
+
+template<Piece piece, typename V>
+__attribute__((always_inline)) inline size_t Run(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    constexpr size_t lanes = sizeof(V) / sizeof(uint64_t);
+    const size_t done = n - n % lanes;
+
+    for (size_t i = 0; i < done; i += lanes) {
+        V o, s, attacks;
+
+        memcpy(&o, occ + i, sizeof(V));
+
+        for (size_t lane = 0; lane < lanes; lane++) {
+            s[lane] = sq[i + lane];
+        }
+
+        attacks = Fill<piece>(~o, (V{} + 1) << s);
+
+        memcpy(out + i, &attacks, sizeof(V));
+    }
+
+    return done;
+}
+
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+AVX2 size_t BishopAvx2(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Bishop, U64x4>(occ, sq, out, n);
+}
+
+AVX2 size_t RookAvx2(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Rook, U64x4>(occ, sq, out, n);
+}
+
+AVX2 size_t QueenAvx2(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Queen, U64x4>(occ, sq, out, n);
+}
+
+bool SupportedAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+AVX512 size_t BishopAvx512(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Bishop, U64x8>(occ, sq, out, n);
+}
+
+AVX512 size_t RookAvx512(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Rook, U64x8>(occ, sq, out, n);
+}
+
+AVX512 size_t QueenAvx512(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    return Run<Queen, U64x8>(occ, sq, out, n);
+}
+
+bool SupportedAvx512()
+{
+    return __builtin_cpu_supports("avx512f");
+}
+}
+
+const BatchKernel Avx2BatchKernel = {
+    "avx2", 4, Batch::BishopAvx2, Batch::RookAvx2, Batch::QueenAvx2, Batch::SupportedAvx2
+};
+
+const BatchKernel Avx512BatchKernel = {
+    "avx512", 8, Batch::BishopAvx512, Batch::RookAvx512, Batch::QueenAvx512, Batch::SupportedAvx512
+};
+
+#endif // #ifdef BBATTACK_X86_TARGETS
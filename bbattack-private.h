@@ -25,8 +25,16 @@
 #ifndef BBATTACK_PRIVATE_H
 #define BBATTACK_PRIVATE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+// Code for optional instruction set extensions (BMI2, AVX2, AVX-512) needs an
+// x86 compiler that understands target attributes, so that it can be built
+// next to the portable code and picked at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BBATTACK_X86_TARGETS
+#endif
+
 enum Direction {
     North,
     South,
@@ -82,8 +90,9 @@ constexpr bool DirIsWest[8] = {
     true   // Northwest
 };
 
-template<int shift>
-uint64_t Shift(uint64_t x)
+// T is uint64_t, or a GCC vector of them when working on several positions.
+template<int shift, typename T>
+constexpr T Shift(T x)
 {
     if (shift > 0) {
         return x << shift;
@@ -92,13 +101,13 @@ uint64_t Shift(uint64_t x)
     }
 }
 
-uint64_t Swap(uint64_t x)
+inline uint64_t Swap(uint64_t x)
 {
     return __builtin_bswap64(x);
 }
 
 template<Direction dir>
-bool OnBoard(const int sq)
+constexpr bool OnBoard(const int sq)
 {
     constexpr int inc = DirShift[dir];
     const int file = sq % 8;
@@ -123,13 +132,13 @@ bool OnBoard(const int sq)
 }
 
 template<Direction dir, bool exclude_outer>
-uint64_t GenMask(const unsigned int sq)
+constexpr uint64_t GenMask(const unsigned int sq)
 {
     static_assert(dir >= 0 && dir <= 7, "Direction out of range");
 
     uint64_t bb = 0;
     constexpr int inc = DirShift[dir];
-    int dest;
+    int dest = 0;
 
     const uint64_t outer_mask[8] = {
         0x00FFFFFFFFFFFFFFULL, // North
@@ -154,4 +163,322 @@ uint64_t GenMask(const unsigned int sq)
     return bb;
 }
 
+// Steffan Westcott's Kogge-Stone occluded fill. It works set-wise, so fill
+// can hold any number of sliders, and T can be a vector of bitboards, one
+// position per lane. Always inlined, so that vector callers compiled for
+// AVX2 or AVX-512 never pass their registers to an out-of-line copy built
+// for the baseline ABI.
+namespace KoggeStone {
+template<int dir, typename T>
+__attribute__((always_inline)) inline T KoggeStone(T empty, T fill)
+{
+    static_assert(dir >= 0 && dir <= 7, "Direction out of range");
+    constexpr int shift = DirShift[dir];
+    constexpr uint64_t mask = DirMask[dir];
+    empty &= mask;
+    fill |= empty & Shift<shift  >(fill);
+    empty = empty & Shift<shift  >(empty);
+    fill |= empty & Shift<shift*2>(fill);
+    empty = empty & Shift<shift*2>(empty);
+    fill |= empty & Shift<shift*4>(fill);
+    return  mask  & Shift<shift  >(fill);
+}
+}
+
+// Reference helpers for building lookup tables: enumerate the subsets of a
+// mask, the relevant-occupancy masks and slow but obviously correct attacks.
+
+// Steffan Westcott's innovation.
+constexpr uint64_t SNOOB(const uint64_t set, const uint64_t subset)
+{
+    return (subset - set) & set;
+}
+
+constexpr uint64_t CalcRookMask(int sq)
+{
+    uint64_t result = 0;
+
+    result |= GenMask<North, true>(sq);
+    result |= GenMask<South, true>(sq);
+    result |= GenMask<East,  true>(sq);
+    result |= GenMask<West,  true>(sq);
+   
+    return result;
+}
+
+constexpr uint64_t CalcBishopMask(int sq)
+{
+    uint64_t result = 0;
+    
+    result |= GenMask<Northeast, true>(sq);
+    result |= GenMask<Southeast, true>(sq);
+    result |= GenMask<Northwest, true>(sq);
+    result |= GenMask<Southwest, true>(sq);
+
+    return result;
+}
+
+// Likewise.
+constexpr uint64_t CalcRookAttacks(int sq, uint64_t block)
+{
+    uint64_t result = 0ULL;
+    int rk = sq/8, fl = sq%8, r = 0, f = 0;
+    for (r = rk+1; r <= 7; r++) {
+        result |= (1ULL << (fl + r*8));
+        if(block & (1ULL << (fl + r*8))) {
+            break;
+        }
+    }
+    for (r = rk-1; r >= 0; r--) {
+        result |= (1ULL << (fl + r*8));
+        if(block & (1ULL << (fl + r*8))) {
+            break;
+        }
+    }
+    for (f = fl+1; f <= 7; f++) {
+        result |= (1ULL << (f + rk*8));
+        if(block & (1ULL << (f + rk*8))) {
+            break;
+        }
+    }
+    for (f = fl-1; f >= 0; f--) {
+        result |= (1ULL << (f + rk*8));
+        if(block & (1ULL << (f + rk*8))) {
+            break;
+        }
+    }
+    return result;
+}
+
+// Likewise. At this point I'll be banned from all ICGA tournaments.
+// Such is the price of laziness.
+constexpr uint64_t CalcBishopAttacks(int sq, uint64_t block)
+{
+    uint64_t result = 0ULL;
+    int rk = sq/8, fl = sq%8, r = 0, f = 0;
+    for(r = rk+1, f = fl+1; r <= 7 && f <= 7; r++, f++) {
+        result |= (1ULL << (f + r*8));
+        if(block & (1ULL << (f + r * 8))) {
+            break;
+        }
+    }
+    for(r = rk+1, f = fl-1; r <= 7 && f >= 0; r++, f--) {
+        result |= (1ULL << (f + r*8));
+        if(block & (1ULL << (f + r * 8))) {
+            break;
+        }
+    }
+    for(r = rk-1, f = fl+1; r >= 0 && f <= 7; r--, f++) {
+        result |= (1ULL << (f + r*8));
+        if(block & (1ULL << (f + r * 8))) {
+            break;
+        }
+    }
+    for(r = rk-1, f = fl-1; r >= 0 && f >= 0; r--, f--) {
+        result |= (1ULL << (f + r*8));
+        if(block & (1ULL << (f + r * 8))) {
+            break;
+        }
+    }
+    return result;
+}
+
+// Numbering of a square's distinct attack sets, for magic-dedup: a set is
+// decided by how far each of the square's four rays reaches, so those
+// reaches make the digits of a mixed-radix number, and no searching is
+// needed. SetCount() is how many numbers a square uses.
+template<Direction a, Direction b, Direction c, Direction d>
+constexpr unsigned int SetCount(const int sq)
+{
+    const unsigned int la = __builtin_popcountll(GenMask<a, false>(sq));
+    const unsigned int lb = __builtin_popcountll(GenMask<b, false>(sq));
+    const unsigned int lc = __builtin_popcountll(GenMask<c, false>(sq));
+    const unsigned int ld = __builtin_popcountll(GenMask<d, false>(sq));
+
+    return (la ? la : 1) * (lb ? lb : 1) * (lc ? lc : 1) * (ld ? ld : 1);
+}
+
+template<Direction dir>
+constexpr unsigned int SetDigit(const int sq, const uint64_t attacks, const unsigned int id)
+{
+    const uint64_t ray = GenMask<dir, false>(sq);
+    const unsigned int length = __builtin_popcountll(ray);
+
+    return length ? id * length + __builtin_popcountll(attacks & ray) - 1 : id;
+}
+
+template<Direction a, Direction b, Direction c, Direction d>
+constexpr unsigned int SetId(const int sq, const uint64_t attacks)
+{
+    return SetDigit<d>(sq, attacks, SetDigit<c>(sq, attacks, SetDigit<b>(sq, attacks, SetDigit<a>(sq, attacks, 0))));
+}
+
+constexpr unsigned int BishopSetCount(const int sq)
+{
+    return SetCount<Northeast, Southeast, Southwest, Northwest>(sq);
+}
+
+constexpr unsigned int RookSetCount(const int sq)
+{
+    return SetCount<North, South, East, West>(sq);
+}
+
+constexpr unsigned int BishopSetId(const int sq, const uint64_t attacks)
+{
+    return SetId<Northeast, Southeast, Southwest, Northwest>(sq, attacks);
+}
+
+constexpr unsigned int RookSetId(const int sq, const uint64_t attacks)
+{
+    return SetId<North, South, East, West>(sq, attacks);
+}
+
+// Every square's numbers in turn, bishops first, make one pool.
+constexpr unsigned int SetPoolSize()
+{
+    unsigned int size = 0;
+    int sq = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        size += BishopSetCount(sq) + RookSetCount(sq);
+    }
+
+    return size;
+}
+
+// Table files (see tablefile.cpp) let a backend's big table be built once,
+// saved, and then mapped read-only by every process that wants it. A
+// backend that can do this describes its table with Image() and switches
+// its lookups over to a mapped copy with Adopt(). Hash covers whatever
+// decides the layout and contents (magics, shifts, masks, offsets), so a
+// file made by a differently-configured build gets turned away.
+struct TableImage {
+    uint64_t Hash;
+    const void* Data;
+    size_t Size;
+    const unsigned int* BishopOffset;
+    const unsigned int* RookOffset;
+};
+
+struct TableSource {
+    const char* Name;
+    uint32_t Id; // Stable; written to files.
+    void (*Image)(TableImage* image);
+    void (*Adopt)(const void* data);
+};
+
+int WriteTableFile(const char* name, const char* path);
+
+extern const TableSource MagicTableSource;
+extern const TableSource BlackMagicTableSource;
+#ifdef BBATTACK_X86_TARGETS
+extern const TableSource PextTableSource;
+#endif
+
+// 64-bit FNV-1a, for table hashes and file checksums.
+inline uint64_t Fnv1a(const void* data, const size_t size, uint64_t hash = 0xCBF29CE484222325ULL)
+{
+    const uint8_t* p = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+template<typename T>
+uint64_t TableHash(const T& x, const uint64_t hash = 0xCBF29CE484222325ULL)
+{
+    return Fnv1a(&x, sizeof(x), hash);
+}
+
+// Zeroed, 64-byte aligned memory for a big table, put on huge pages when
+// the system allows. With fallback false, returns null rather than settle
+// for ordinary pages. See pages.cpp.
+void* TableAlloc(const size_t size, const bool fallback);
+
+// Give back a table from TableAlloc(). Nobody may still be reading it.
+void TableFree(void* p, const size_t size);
+
+// Whether BBATTACK_HUGE_PAGES=1 asks for tables in shared read-only memory
+// to be copied onto huge pages all the same.
+bool TableCopyWanted();
+
+// X-rays from two lookups: take the first blockers that are in blockers off
+// the board and look again; what's new is the second layer. Backends that
+// can't find their first blocker any cheaper than a whole lookup use this
+// with their own lookup, so the second one hits the same cache lines.
+template<uint64_t (*attack)(const uint64_t occ, const unsigned int sq)>
+uint64_t Xray(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    const uint64_t attacks = attack(occ, sq);
+
+    return attacks ^ attack(occ & ~(attacks & blockers), sq);
+}
+
+// Every attack generation system lives in its own namespace and exports
+// one of these; bbattack.cpp picks which one the public API forwards to.
+struct Backend {
+    const char* Name;
+    void (*Init)();
+    uint64_t (*Bishop)(const uint64_t occ, const unsigned int sq);
+    uint64_t (*Rook)(const uint64_t occ, const unsigned int sq);
+    uint64_t (*Queen)(const uint64_t occ, const unsigned int sq);
+    uint64_t (*XrayBishop)(const uint64_t occ, const uint64_t blockers, const unsigned int sq);
+    uint64_t (*XrayRook)(const uint64_t occ, const uint64_t blockers, const unsigned int sq);
+
+    // Whether this CPU can run the backend at all; null means always.
+    bool (*Supported)();
+
+    // The same backend, but building its tables a square at a time as
+    // lookups first need them (see BBAttackInitLazy()); null if it has
+    // nothing worth putting off.
+    const struct Backend* Lazy;
+
+    // Give back the tables Init() built, after calibration has timed the
+    // backend and picked another, so that only the winner's stay resident;
+    // Init() builds them again if the backend is selected later. Null if
+    // Init() builds nothing big.
+    void (*Release)();
+};
+
+extern const Backend ClassicalBackend;
+extern const Backend Dumb7FillBackend;
+extern const Backend HyperbolaBackend;
+extern const Backend KindergartenBackend;
+extern const Backend ObstructionBackend;
+extern const Backend KoggeStoneBackend;
+extern const Backend MagicBackend;
+extern const Backend MagicDedupBackend;
+extern const Backend BlackMagicBackend;
+extern const Backend SBAMGBackend;
+#ifdef BBATTACK_X86_TARGETS
+extern const Backend PextBackend;
+extern const Backend PextPdepBackend;
+extern const Backend KoggeStoneAvx2Backend;
+extern const Backend HyperbolaSsse3Backend;
+extern const Backend HyperbolaAvx2Backend;
+#endif
+#ifdef BBATTACK_SWITCH
+extern const Backend SwitchBackend;
+#endif
+
+// Multi-position kernels behind the BBAttack*Batch() calls. Each handles
+// n rounded down to a multiple of Lanes and returns how many it did; the
+// caller finishes the rest one at a time.
+struct BatchKernel {
+    const char* Name;
+    size_t Lanes;
+    size_t (*Bishop)(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n);
+    size_t (*Rook)(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n);
+    size_t (*Queen)(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n);
+    bool (*Supported)();
+};
+
+#ifdef BBATTACK_X86_TARGETS
+extern const BatchKernel Avx2BatchKernel;
+extern const BatchKernel Avx512BatchKernel;
+#endif
+
 #endif // #ifndef BBATTACK_PRIVATE_H
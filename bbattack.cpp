@@ -0,0 +1,543 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+namespace {
+    const Backend* const Backends[] = {
+        &ClassicalBackend,
+        &Dumb7FillBackend,
+        &HyperbolaBackend,
+        &KindergartenBackend,
+        &ObstructionBackend,
+        &KoggeStoneBackend,
+        &MagicBackend,
+        &MagicDedupBackend,
+        &BlackMagicBackend,
+        &SBAMGBackend,
+#ifdef BBATTACK_X86_TARGETS
+        &PextBackend,
+        &PextPdepBackend,
+        &KoggeStoneAvx2Backend,
+        &HyperbolaSsse3Backend,
+        &HyperbolaAvx2Backend,
+#endif
+#ifdef BBATTACK_SWITCH
+        &SwitchBackend,
+#endif
+    };
+
+#if defined(USE_CLASSICAL)
+    const char* const ForcedBackend = "classical";
+#elif defined(USE_DUMB7FILL)
+    const char* const ForcedBackend = "dumb7fill";
+#elif defined(USE_HYPERBOLA)
+    const char* const ForcedBackend = "hyperbola";
+#elif defined(USE_KINDERGARTEN)
+    const char* const ForcedBackend = "kindergarten";
+#elif defined(USE_OBSTRUCTION)
+    const char* const ForcedBackend = "obstruction";
+#elif defined(USE_KOGGE_STONE)
+    const char* const ForcedBackend = "kogge-stone";
+#elif defined(USE_MAGIC)
+    const char* const ForcedBackend = "magic";
+#elif defined(USE_MAGIC_DEDUP)
+    const char* const ForcedBackend = "magic-dedup";
+#elif defined(USE_BLACK_MAGIC)
+    const char* const ForcedBackend = "black-magic";
+#elif defined(USE_SBAMG)
+    const char* const ForcedBackend = "sbamg";
+#elif defined(USE_PEXT)
+    const char* const ForcedBackend = "pext";
+#elif defined(USE_PEXT_PDEP)
+    const char* const ForcedBackend = "pext-pdep";
+#elif defined(USE_KOGGE_STONE_AVX2)
+    const char* const ForcedBackend = "kogge-stone-avx2";
+#elif defined(USE_HYPERBOLA_SSSE3)
+    const char* const ForcedBackend = "hyperbola-ssse3";
+#elif defined(USE_HYPERBOLA_AVX2)
+    const char* const ForcedBackend = "hyperbola-avx2";
+#elif defined(USE_SWITCH)
+    const char* const ForcedBackend = "switch";
+#else
+    const char* const ForcedBackend = nullptr;
+#endif
+
+    const BatchKernel* const BatchKernels[] = {
+#ifdef BBATTACK_X86_TARGETS
+        &Avx512BatchKernel,
+        &Avx2BatchKernel,
+#endif
+        nullptr // Look everything up one at a time with the active backend.
+    };
+
+    constexpr size_t BackendCount = sizeof(Backends) / sizeof(Backends[0]);
+
+    // Kogge-Stone needs no tables, so it gives correct answers even if
+    // somebody forgets to call BBAttackInit().
+    //
+    // Threads may select backends and look things up at the same time. A
+    // backend's tables are complete before it is published here, and the
+    // acquire loads on the lookup side (plain loads on x86) make sure the
+    // reader sees them.
+    std::atomic<const Backend*> Active(&KoggeStoneBackend);
+
+    std::atomic<const BatchKernel*> ActiveBatch(nullptr);
+
+    // Set once BBAttackSelect() has been called, so that a later
+    // BBAttackInit() doesn't undo the caller's choice.
+    std::atomic<bool> Selected(false);
+
+    // Set by BBAttackInitLazy(), so that backends are bound in their lazy
+    // form where they have one.
+    std::atomic<bool> Lazy(false);
+
+    std::atomic<BBAttackState> State(BBAttackUninitialised);
+
+    std::once_flag InitOnce;
+    std::once_flag InitLazyOnce;
+
+    // Whose Init() has run, eager and lazy form, under PrepareLock.
+    // Release() can undo it, so these aren't once_flags.
+    std::mutex PrepareLock;
+    bool Prepared[BackendCount];
+    bool LazyPrepared[BackendCount];
+
+    const BatchKernel* CurrentBatch()
+    {
+        return ActiveBatch.load(std::memory_order_acquire);
+    }
+
+    bool Supported(const Backend* backend)
+    {
+        return backend->Supported == nullptr || backend->Supported();
+    }
+
+    const Backend* Current()
+    {
+        return Active.load(std::memory_order_acquire);
+    }
+
+    // Run a backend's Init(), or its lazy form's, once, even if several
+    // threads want it at the same time. Everyone else waits until it's
+    // done.
+    void Prepare(const Backend* backend)
+    {
+        std::lock_guard<std::mutex> lock(PrepareLock);
+
+        for (size_t i = 0; i < BackendCount; i++) {
+            if (Backends[i] == backend) {
+                if (!Prepared[i]) {
+                    backend->Init();
+                    Prepared[i] = true;
+                }
+
+                return;
+            }
+
+            if (Backends[i]->Lazy == backend) {
+                if (!LazyPrepared[i]) {
+                    backend->Init();
+                    LazyPrepared[i] = true;
+                }
+
+                return;
+            }
+        }
+    }
+
+    // Give back the tables of every backend calibration didn't pick, bar
+    // those sharing the winner's (pext and pext-pdep have one table
+    // between them). Their lazy forms rebuild on demand by themselves.
+    void ReleaseLosers(const Backend* winner)
+    {
+        std::lock_guard<std::mutex> lock(PrepareLock);
+
+        for (size_t i = 0; i < BackendCount; i++) {
+            if (Backends[i]->Release != nullptr && Backends[i]->Release != winner->Release) {
+                Backends[i]->Release();
+                Prepared[i] = false;
+            }
+        }
+    }
+
+    // Whether a backend's tables are all there, rather than built on
+    // demand.
+    bool Eager(const Backend* backend)
+    {
+        for (const Backend* eager : Backends) {
+            if (eager == backend) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const Backend* Find(const char* name)
+    {
+        for (const Backend* backend : Backends) {
+            if (strcmp(backend->Name, name) == 0 && Supported(backend)) {
+                return backend;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The calibration sample: a fixed pseudo-random spread of squares and
+    // occupancies between roughly an eighth and a half full, which covers
+    // everything from the opening to the endgame.
+    constexpr int SampleSize = 1024;
+    constexpr int SampleRounds = 5;
+
+    struct Query {
+        uint64_t occ;
+        unsigned int sq;
+    };
+
+    uint64_t XorShift(uint64_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    void GenSample(Query* sample)
+    {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+        for (int i = 0; i < SampleSize; i++) {
+            uint64_t occ = XorShift(state) & XorShift(state);
+
+            if (i & 1) {
+                occ &= XorShift(state);
+            }
+
+            sample[i].sq = XorShift(state) & 63;
+            sample[i].occ = occ | (1ULL << sample[i].sq);
+        }
+    }
+
+    // Handle whatever a batch kernel left over, or everything if there is
+    // no kernel, with the active backend.
+    template<uint64_t (*Backend::*attack)(const uint64_t occ, const unsigned int sq)>
+    void Batch(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n, size_t done)
+    {
+        for (; done < n; done++) {
+            out[done] = (Current()->*attack)(occ[done], sq[done]);
+        }
+    }
+
+    // Best-of-N wall clock time for one pass of bishop and rook lookups
+    // over the sample, in nanoseconds.
+    int64_t Time(const Backend* backend, const Query* sample)
+    {
+        using Clock = std::chrono::steady_clock;
+        int64_t best = INT64_MAX;
+        volatile uint64_t sink = 0;
+
+        for (int round = 0; round < SampleRounds; round++) {
+            uint64_t acc = 0;
+            const Clock::time_point start = Clock::now();
+
+            for (int i = 0; i < SampleSize; i++) {
+                acc ^= backend->Bishop(sample[i].occ, sample[i].sq);
+                acc ^= backend->Rook(sample[i].occ, sample[i].sq);
+            }
+
+            const Clock::time_point end = Clock::now();
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            sink = sink ^ acc;
+
+            if (ns < best) {
+                best = ns;
+            }
+        }
+
+        return best;
+    }
+
+    // Likewise, for batched bishop and rook lookups through a batch kernel.
+    int64_t Time(const BatchKernel* kernel, const Query* sample)
+    {
+        using Clock = std::chrono::steady_clock;
+        static uint64_t occ[SampleSize];
+        static uint8_t sq[SampleSize];
+        static uint64_t out[SampleSize];
+        int64_t best = INT64_MAX;
+
+        for (int i = 0; i < SampleSize; i++) {
+            occ[i] = sample[i].occ;
+            sq[i] = sample[i].sq;
+        }
+
+        for (int round = 0; round < SampleRounds; round++) {
+            const Clock::time_point start = Clock::now();
+
+            if (kernel != nullptr) {
+                Batch<&Backend::Bishop>(occ, sq, out, SampleSize, kernel->Bishop(occ, sq, out, SampleSize));
+                Batch<&Backend::Rook>(occ, sq, out, SampleSize, kernel->Rook(occ, sq, out, SampleSize));
+            } else {
+                Batch<&Backend::Bishop>(occ, sq, out, SampleSize, 0);
+                Batch<&Backend::Rook>(occ, sq, out, SampleSize, 0);
+            }
+
+            const Clock::time_point end = Clock::now();
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+            if (ns < best) {
+                best = ns;
+            }
+        }
+
+        return best;
+    }
+
+    // Bind the backend named by the environment or a USE_* define, or else
+    // the one that runs the sample fastest. Timing a backend means building
+    // its tables, so those of the backends that lose are given back
+    // afterwards, and only the winner's stay resident. Without a sample
+    // (lazy init) there is no timing everything, so take magic: its tables
+    // are built by the compiler.
+    void Bind(const Query* sample)
+    {
+        const char* name = getenv("BBATTACK_BACKEND");
+
+        if (name != nullptr && *name != '\0') {
+            if (BBAttackSelect(name) == 0) {
+                return;
+            }
+
+            fprintf(stderr, "bbattack: unknown backend \"%s\" in BBATTACK_BACKEND, ignoring\n", name);
+        }
+
+        if (ForcedBackend != nullptr) {
+            BBAttackSelect(ForcedBackend);
+            return;
+        }
+
+        if (sample == nullptr) {
+            Prepare(&MagicBackend);
+            Active.store(&MagicBackend, std::memory_order_release);
+            return;
+        }
+
+        const Backend* fastest = nullptr;
+        int64_t fastest_time = INT64_MAX;
+
+        for (const Backend* backend : Backends) {
+            if (!Supported(backend)) {
+                continue;
+            }
+
+            Prepare(backend);
+
+            const int64_t time = Time(backend, sample);
+
+            if (time < fastest_time) {
+                fastest = backend;
+                fastest_time = time;
+            }
+        }
+
+        Active.store(fastest, std::memory_order_release);
+        ReleaseLosers(fastest);
+    }
+
+    // Vector kernels only win if they beat a loop over the active backend.
+    // Without a sample (a lazy backend, which timing would build in full)
+    // take the widest kernel the CPU has.
+    void BindBatch(const Query* sample)
+    {
+        const BatchKernel* fastest = nullptr;
+        int64_t fastest_time = INT64_MAX;
+
+        for (const BatchKernel* kernel : BatchKernels) {
+            if (kernel != nullptr && !kernel->Supported()) {
+                continue;
+            }
+
+            if (sample == nullptr) {
+                fastest = kernel;
+                break;
+            }
+
+            const int64_t time = Time(kernel, sample);
+
+            if (time < fastest_time) {
+                fastest = kernel;
+                fastest_time = time;
+            }
+        }
+
+        ActiveBatch.store(fastest, std::memory_order_release);
+    }
+}
+
+extern "C" {
+uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+{
+    return Current()->Bishop(occ, sq);
+}
+
+uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+{
+    return Current()->Rook(occ, sq);
+}
+
+uint64_t BBAttackQueen(const uint64_t occ, const unsigned int sq)
+{
+    return Current()->Queen(occ, sq);
+}
+
+uint64_t BBXrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Current()->XrayBishop(occ, blockers, sq);
+}
+
+uint64_t BBXrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Current()->XrayRook(occ, blockers, sq);
+}
+
+int BBAttackSelect(const char* name)
+{
+    const Backend* backend = Find(name);
+
+    if (backend == nullptr) {
+        return -1;
+    }
+
+    if (Lazy.load() && backend->Lazy != nullptr) {
+        backend = backend->Lazy;
+    }
+
+    Prepare(backend);
+
+    Active.store(backend, std::memory_order_release);
+    Selected = true;
+
+    return 0;
+}
+
+const char* BBAttackBackend()
+{
+    return Current()->Name;
+}
+
+const char* BBAttackBackendName(const unsigned int index)
+{
+    if (index >= sizeof(Backends) / sizeof(Backends[0])) {
+        return nullptr;
+    }
+
+    return Backends[index]->Name;
+}
+
+void BBAttackBishopBatch(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    const BatchKernel* kernel = CurrentBatch();
+
+    Batch<&Backend::Bishop>(occ, sq, out, n, kernel ? kernel->Bishop(occ, sq, out, n) : 0);
+}
+
+void BBAttackRookBatch(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    const BatchKernel* kernel = CurrentBatch();
+
+    Batch<&Backend::Rook>(occ, sq, out, n, kernel ? kernel->Rook(occ, sq, out, n) : 0);
+}
+
+void BBAttackQueenBatch(const uint64_t* occ, const uint8_t* sq, uint64_t* out, const size_t n)
+{
+    const BatchKernel* kernel = CurrentBatch();
+
+    Batch<&Backend::Queen>(occ, sq, out, n, kernel ? kernel->Queen(occ, sq, out, n) : 0);
+}
+
+const char* BBAttackBatchKernel()
+{
+    const BatchKernel* kernel = CurrentBatch();
+
+    return kernel ? kernel->Name : "scalar";
+}
+
+void BBAttackInit()
+{
+    std::call_once(InitOnce, [] {
+        static Query sample[SampleSize];
+
+        Lazy = false;
+        GenSample(sample);
+
+        if (!Selected) {
+            Bind(sample);
+        }
+
+        BindBatch(sample);
+        State = BBAttackReady;
+    });
+}
+
+void BBAttackInitLazy()
+{
+    std::call_once(InitLazyOnce, [] {
+        static Query sample[SampleSize];
+        BBAttackState uninitialised = BBAttackUninitialised;
+
+        Lazy = true;
+        GenSample(sample);
+
+        if (!Selected) {
+            Bind(nullptr);
+        }
+
+        if (State.load() != BBAttackReady) {
+            BindBatch(Eager(Current()) ? sample : nullptr);
+        }
+
+        State.compare_exchange_strong(uninitialised, BBAttackLazy);
+    });
+}
+
+BBAttackState BBAttackInitState()
+{
+    return State.load();
+}
+}
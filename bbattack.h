@@ -25,61 +25,449 @@
 #ifndef BBATTACK_H
 #define BBATTACK_H
 
+#include <stddef.h>
 #include <stdint.h>
 
-// Which bitboard attack generation system should be used?
-// Note: don't define multiple attack systems, because you'll get linker errors.
+// Every attack generation system below is linked in. By default,
+// BBAttackInit() times each of them on a small built-in sample and binds
+// the fastest, so one build adapts to the machine it runs on.
+//
+// To force a particular one, either call BBAttackSelect(), set the
+// BBATTACK_BACKEND environment variable to its name, or define exactly one
+// of the following. BBAttackSelect() beats the environment, which beats
+// the define. None of them reach BBATTACK_INLINE's lookups, which are
+// always magic (see below).
 
-// The classical approach from Chess 4.5.
+// The classical approach from Chess 4.5. ("classical")
 // Low memory, medium speed.
-#define USE_CLASSICAL
+//#define USE_CLASSICAL
 
-// Dumb7Fill, based on the code from the Chess Programming Wiki.
+// Dumb7Fill, based on the code from the Chess Programming Wiki. ("dumb7fill")
 // Near-zero memory, very slow, could be faster with a smart compiler.
 //#define USE_DUMB7FILL
 
-// Hyperbola Quintessence, based in part on the code from Amoeba.
+// Hyperbola Quintessence, based in part on the code from Amoeba. ("hyperbola")
 // Low memory, reasonably fast, worse on Intel compared to AMD.
 //#define USE_HYPERBOLA
 
-// Michael Hoffman's Obstruction Difference. Similiarish to HQ.
+// Hyperbola Quintessence with both diagonals in one SSE register, and a
+// byte shuffle for the swap. Ranks and files are as above. Only offered on
+// CPUs with SSSE3. ("hyperbola-ssse3")
+// Low memory, more throughput than plain HQ for bishops and queens, but a
+// little more latency, what with moving between register files.
+//#define USE_HYPERBOLA_SSSE3
+
+// As above, with the queen's file in the same (AVX2) register as its
+// diagonals. Only offered on CPUs with AVX2. ("hyperbola-avx2")
+// Low memory, more queen throughput again than the SSSE3 version.
+//#define USE_HYPERBOLA_AVX2
+
+// Gerd Isenberg's kindergarten bitboards: each line is collapsed to a
+// 6-bit index with one multiply. ("kindergarten")
+// Low memory (about 9K, all of it L1-sized), fast, no branches.
+//#define USE_KINDERGARTEN
+
+// Michael Hoffman's Obstruction Difference. Similiarish to HQ. ("obstruction")
 // Low memory, reasonably fast. 
 //#define USE_OBSTRUCTION
 
-// Steffan Westcott's Kogge-Stone algorithm.
+// Steffan Westcott's Kogge-Stone algorithm. ("kogge-stone")
 // Near-zero memory, faster than Dumb7Fill.
 //#define USE_KOGGE_STONE
 
-// Volker Annuss' fixed-shift fancy magic bitboards.
-// High memory, very fast.
+// Kogge-Stone again, with all four directions of a piece filled at once in
+// one AVX2 register. Only offered on CPUs with AVX2. ("kogge-stone-avx2")
+// Near-zero memory, faster than scalar Kogge-Stone when lookups overlap.
+//#define USE_KOGGE_STONE_AVX2
+
+// Volker Annuss' fixed-shift fancy magic bitboards. ("magic")
+// High memory, very fast. The tables come ready made (magic-annuss-tables.h)
+// and live in read-only memory, so processes share them; BBATTACK_HUGE_PAGES=1
+// has init move a private copy onto huge pages instead (see BBAttackPageReport).
 //#define USE_MAGIC
 
-// Syed Fahad's Subtraction-based Attack Mask Generation algorithm.
+// The same magics, but the table holds 16-bit ids into a pool of each
+// square's distinct attack sets. ("magic-dedup")
+// Medium memory (about a third of USE_MAGIC's), one more load per lookup.
+//#define USE_MAGIC_DEDUP
+
+// Black magic bitboards: the same multiply, but on occ | ~mask, which lets
+// sub-tables overlap in more ways. ("black-magic")
+// High memory, very fast, read-only tables like USE_MAGIC: the published
+// black magics (magic-black.h) pack into 87988 entries against Volker's
+// 89524, about 12K less to keep in cache.
+//#define USE_BLACK_MAGIC
+
+// Syed Fahad's Subtraction-based Attack Mask Generation algorithm. ("sbamg")
 // Low memory, about HQ speed.
 //#define USE_SBAMG
 
-// Dann Corbit's "switch" approach. May God have mercy on your soul.
+// Fancy bitboards indexed with the BMI2 PEXT instruction instead of a magic
+// multiply. Only offered on CPUs with BMI2. ("pext")
+// High memory, very fast where PEXT is quick, very slow where it's microcoded.
+//#define USE_PEXT
+
+// As above, but each entry is the attack set squeezed to 16 bits, which PDEP
+// expands again. ("pext-pdep")
+// Medium memory, a touch slower per lookup than plain PEXT.
+//#define USE_PEXT_PDEP
+
+// Dann Corbit's "switch" approach. May God have mercy on your soul. ("switch")
 // Zero memory, very long compile time, about Kogge-Stone speed.
+// This one is generated by tools/switch.cpp and is only linked in when
+// BBATTACK_SWITCH is defined; USE_SWITCH implies it. The generator can
+// split it into files that compile in parallel, or emit perfect-hash
+// tables instead of switches, which take seconds and run at magic speed.
 //#define USE_SWITCH
 
+#if defined(USE_CLASSICAL) + defined(USE_DUMB7FILL) + defined(USE_HYPERBOLA) + \
+    defined(USE_OBSTRUCTION) + defined(USE_KOGGE_STONE) + defined(USE_MAGIC) + \
+    defined(USE_SBAMG) + defined(USE_PEXT) + defined(USE_PEXT_PDEP) + \
+    defined(USE_KOGGE_STONE_AVX2) + defined(USE_SWITCH) + \
+    defined(USE_BLACK_MAGIC) + defined(USE_MAGIC_DEDUP) + defined(USE_KINDERGARTEN) + \
+    defined(USE_HYPERBOLA_SSSE3) + defined(USE_HYPERBOLA_AVX2) > 1
+#error "Only one attack generation system can be forced at a time."
+#endif
+
+#if defined(USE_SWITCH) && !defined(BBATTACK_SWITCH)
+#define BBATTACK_SWITCH
+#endif
+
+// Define BBATTACK_INLINE before including this header to have the bishop,
+// rook, queen and x-ray lookups defined right here as static inline
+// functions instead of calls into the library, so the compiler can keep
+// the per-square entries in registers across a loop and interleave the
+// lookups for several pieces.
+//
+// Inline mode means magic only. USE_MAGIC is implied if nothing is forced,
+// and forcing anything else is an error. The inline lookups use magic even
+// when BBAttackSelect(), BBATTACK_BACKEND or calibration bind another
+// backend, PEXT included; BBAttackBackend() reports that other backend,
+// which only the out-of-line functions use. PEXT isn't offered inline
+// because its table is built at run time, square by square in lazy mode,
+// and is freed again if it loses calibration, where magic's tables are
+// static data that work before BBAttackInit() too.
+//
+// The tables themselves stay in the library, along with the out-of-line
+// functions for C code and other translation units; the library's own
+// sources define BBATTACK_BUILDING_LIBRARY, so they never see the inline
+// versions.
+#if defined(BBATTACK_INLINE) && !defined(BBATTACK_BUILDING_LIBRARY)
+#if defined(USE_CLASSICAL) + defined(USE_DUMB7FILL) + defined(USE_HYPERBOLA) + \
+    defined(USE_OBSTRUCTION) + defined(USE_KOGGE_STONE) + \
+    defined(USE_SBAMG) + defined(USE_PEXT) + defined(USE_PEXT_PDEP) + \
+    defined(USE_KOGGE_STONE_AVX2) + defined(USE_SWITCH) + \
+    defined(USE_BLACK_MAGIC) + defined(USE_MAGIC_DEDUP) + defined(USE_KINDERGARTEN) + \
+    defined(USE_HYPERBOLA_SSSE3) + defined(USE_HYPERBOLA_AVX2) > 0
+#error "BBATTACK_INLINE only works with USE_MAGIC; its lookups are always magic."
+#endif
+
+#ifndef USE_MAGIC
+#define USE_MAGIC
+#endif
+
+#define BBATTACK_LOOKUP static inline
+#else
+#define BBATTACK_LOOKUP extern
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif // #ifdef __cplusplus
 
-// Initialisation code
+// Initialisation code. Safe to call from several threads at once, and
+// more than once; only the first call does anything, and the others wait
+// for it to finish. Lookups made before it still give the right answers,
+// just slowly.
 extern void BBAttackInit();
 
+// Lazy initialisation, for short-lived programs that only make a few
+// lookups: binds a backend without timing them all (the one named by the
+// environment or a USE_* define, else magic), and backends with tables to
+// build at run time fill in each square the first time it's looked up. The
+// batch kernel is timed against the backend as usual, unless that would
+// build its tables, in which case it's the widest one the CPU has.
+extern void BBAttackInitLazy();
+
+// How far initialisation has got.
+enum BBAttackState {
+    BBAttackUninitialised, // Neither of the above has been called yet.
+    BBAttackLazy,          // BBAttackInitLazy() has finished.
+    BBAttackReady          // BBAttackInit() has finished.
+};
+
+extern enum BBAttackState BBAttackInitState();
+
+// Force the named attack generation system, initialising it if needed (in
+// its lazy form after BBAttackInitLazy()). Safe to call from any thread.
+// Returns 0 on success, or -1 if no system of that name is linked in or
+// this CPU can't run it.
+extern int BBAttackSelect(const char* name);
+
+// Name of the attack generation system currently in use. Under
+// BBATTACK_INLINE, the inline lookups use magic whatever this says.
+extern const char* BBAttackBackend();
+
+// Name of the index'th linked-in attack generation system, or NULL past
+// the end. Meant for benchmarks and tools that want to try them all.
+extern const char* BBAttackBackendName(const unsigned int index);
+
 // Bishop sliding moves
-extern uint64_t BBAttackBishop(const uint64_t occupancy, const unsigned int square);
+BBATTACK_LOOKUP uint64_t BBAttackBishop(const uint64_t occupancy, const unsigned int square);
 
 // Rook sliding moves
-extern uint64_t BBAttackRook(const uint64_t occupancy, const unsigned int square);
+BBATTACK_LOOKUP uint64_t BBAttackRook(const uint64_t occupancy, const unsigned int square);
+
+// Queen sliding moves, worked out in one go by the attack generation system
+// rather than as a bishop lookup and a rook lookup.
+BBATTACK_LOOKUP uint64_t BBAttackQueen(const uint64_t occupancy, const unsigned int square);
+
+// X-ray sliding moves: the squares a bishop or rook on square would
+// attack behind its first blocker in each direction, if that blocker is in
+// blockers (a subset of occupancy; say, your own pieces for discovered
+// attacks, or your own sliders for batteries). The first layer of attacks
+// isn't included, and a ray whose first blocker isn't in blockers gives
+// nothing.
+BBATTACK_LOOKUP uint64_t BBXrayBishop(const uint64_t occupancy, const uint64_t blockers, const unsigned int square);
+BBATTACK_LOOKUP uint64_t BBXrayRook(const uint64_t occupancy, const uint64_t blockers, const unsigned int square);
+
+// Squares strictly between from and to, or 0 if they don't share a rank,
+// file or diagonal.
+extern uint64_t BBBetween(const unsigned int from, const unsigned int to);
+
+// The whole rank, file or diagonal through from and to, both included, or
+// 0 if there isn't one.
+extern uint64_t BBLine(const unsigned int from, const unsigned int to);
+
+// Pieces in own that are pinned to the king on king_square by an enemy
+// rook or queen (enemy_rq) or bishop or queen (enemy_bq). A pinned piece
+// may only move along BBLine(king_square, its square).
+extern uint64_t BBPinned(const uint64_t occupancy, const unsigned int king_square, const uint64_t own, const uint64_t enemy_rq, const uint64_t enemy_bq);
+
+// Enemy sliders giving check to the king on king_square. Knight and pawn
+// checks are left to the caller to OR in.
+extern uint64_t BBCheckers(const uint64_t occupancy, const unsigned int king_square, const uint64_t enemy_rq, const uint64_t enemy_bq);
+
+// Squares a piece other than the king may move to while in check from
+// checkers: anything when not in check, nothing in double check, and
+// otherwise capturing the checker or blocking its ray.
+extern uint64_t BBEvasionMask(const unsigned int king_square, const uint64_t checkers);
+
+// Set-wise sliding moves: the union of the attacks of every slider in
+// sliders, in one pass no matter how many there are. Handy for evaluation,
+// where looping over each piece costs more than it needs to.
+extern uint64_t BBAttackBishopSet(const uint64_t occupancy, const uint64_t sliders);
+extern uint64_t BBAttackRookSet(const uint64_t occupancy, const uint64_t sliders);
+extern uint64_t BBAttackQueenSet(const uint64_t occupancy, const uint64_t sliders);
+
+// Likewise, but only the rays going one way, for pins and king safety.
+// North is towards the eighth rank and east is towards the h-file.
+enum BBDirection {
+    BBNorth,
+    BBSouth,
+    BBEast,
+    BBWest,
+    BBNortheast,
+    BBSoutheast,
+    BBSouthwest,
+    BBNorthwest
+};
+
+extern uint64_t BBAttackRaySet(const uint64_t occupancy, const uint64_t sliders, const enum BBDirection direction);
+
+// Batched sliding moves: out[i] gets the attacks from square[i] given
+// occupancy[i], for n unrelated positions. Much cheaper per query than a
+// loop over the single-position calls, because several positions go
+// through the vector unit at once where the CPU has one.
+extern void BBAttackBishopBatch(const uint64_t* occupancy, const uint8_t* square, uint64_t* out, const size_t n);
+extern void BBAttackRookBatch(const uint64_t* occupancy, const uint8_t* square, uint64_t* out, const size_t n);
+extern void BBAttackQueenBatch(const uint64_t* occupancy, const uint8_t* square, uint64_t* out, const size_t n);
+
+// Name of the batch kernel in use ("avx512", "avx2" or "scalar").
+extern const char* BBAttackBatchKernel();
+
+// Slider attacks kept up to date move by move, for searches that want
+// them at every node. A move changes the occupancy of two squares (four
+// for castling), and only sliders that could see one of those squares need
+// a new lookup; the map finds them from the attacks it already has, and
+// taking a move back restores the saved attacks without any lookups.
+// Lookups go through the current backend.
+//
+// On tools/attack-map.cpp's corpus a make and unmake costs about half of
+// rebuilding the map, attacks-to sets and all, but still two to three
+// times as much as just looking up every slider's attacks again. So it
+// only pays if you want the attacks-to sets.
+//
+// The map only knows which squares are occupied and which of those hold
+// sliders, not colours: AND Attacks and BBAttackMapAttacksTo() with your
+// own pieces.
+#define BBATTACK_MAP_DEPTH 1024
+
+// Room for the attacks saved to take moves back: eight re-looked-up
+// sliders a ply on average over a full BBATTACK_MAP_DEPTH. Plies that might
+// not fit still work, but take back with lookups.
+#define BBATTACK_MAP_SAVED (8 * BBATTACK_MAP_DEPTH)
+
+// Flags for BBAttackMapInit(). With BBATTACK_MAP_ATTACKS_TO the map keeps
+// AttacksTo up to date as well, which makes a move and its unmake about
+// 40% dearer, but an attacks-to query a single load rather than a pass
+// over the sliders.
+#define BBATTACK_MAP_ATTACKS_TO 1
 
-// Helper for queen sliding moves
-static uint64_t BBAttackQueen(const uint64_t occupancy, const unsigned int square)
+enum BBSquareKind {
+    BBEmptySquare,
+    BBNonSlider,      // pawns, knights and kings
+    BBBishopSlider,
+    BBRookSlider,
+    BBQueenSlider
+};
+
+struct BBAttackMap {
+    uint64_t Occupancy;
+    uint64_t Bishops;          // bishops and queens
+    uint64_t Rooks;            // rooks and queens
+    uint64_t Attacks[64];      // attacks of the slider on each square, 0 if none
+    uint64_t AttacksTo[64];    // sliders attacking each square, with BBATTACK_MAP_ATTACKS_TO
+    unsigned int Flags;
+    unsigned int Ply;
+    unsigned int SavedCount;
+    struct {
+        uint64_t Occupancy;    // as they were before
+        uint64_t Bishops;
+        uint64_t Rooks;
+        uint64_t Affected;     // sliders looked up again
+        unsigned int Saved;    // their old attacks in Saved, or BBATTACK_MAP_SAVED if not kept
+    } Undo[BBATTACK_MAP_DEPTH];
+    uint64_t Saved[BBATTACK_MAP_SAVED];
+};
+
+// Set up a map from scratch. bishops and rooks are subsets of occupancy,
+// with queens in both; flags are BBATTACK_MAP_* above, or 0.
+extern void BBAttackMapInit(struct BBAttackMap* map, const uint64_t occupancy, const uint64_t bishops, const uint64_t rooks, const unsigned int flags);
+
+// Move whatever is on from to to, capturing whatever was on to.
+extern void BBAttackMapMakeMove(struct BBAttackMap* map, const unsigned int from, const unsigned int to);
+
+// Put kind on square, replacing whatever was there. Castling is two
+// moves, en passant is a move and clearing the captured pawn's square,
+// and promotion is a move and setting the new piece.
+extern void BBAttackMapSet(struct BBAttackMap* map, const unsigned int square, const enum BBSquareKind kind);
+
+// Take back the last BBAttackMapMakeMove() or BBAttackMapSet().
+extern void BBAttackMapUnmake(struct BBAttackMap* map);
+
+// The sliders attacking square: AttacksTo[square] if the map keeps it, or
+// else worked out from Attacks.
+extern uint64_t BBAttackMapAttacksTo(const struct BBAttackMap* map, const unsigned int square);
+
+// Map a table file made by tools/tables.cpp and use it for that backend's
+// lookups instead of building or copying the table, so every process on
+// the machine shares one physical copy. The file is checked against this
+// build (version, magics, offsets, checksum) first. Returns 0 on success,
+// or -1 if the file can't be read or doesn't match, in which case the
+// backend carries on as if nothing happened. Call it before BBAttackInit()
+// to save building the table at all; called after, it frees the table the
+// backend built, so no other thread may be looking things up with that
+// backend meanwhile.
+extern int BBAttackLoadTables(const char* path);
+
+// How many bytes of lookup tables ended up on explicit huge pages, on
+// transparent huge pages, and on ordinary pages. Big tables built at init
+// try for 2MB pages to save on TLB misses; set BBATTACK_HUGE_PAGES=0 to not
+// bother, or BBATTACK_HUGE_PAGES=1 to have USE_MAGIC's read-only table
+// copied onto them too. Transparent is what the kernel actually backs with
+// huge pages right now, per /proc/self/smaps, out of TransparentRequested.
+struct BBAttackPages {
+    size_t HugeTLB;
+    size_t Transparent;
+    size_t TransparentRequested;
+    size_t Small;
+};
+
+extern void BBAttackPageReport(struct BBAttackPages* pages);
+
+// The magic backend's per-square entries and attack table, exported for
+// BBATTACK_INLINE. An entry has everything a lookup needs besides the
+// table; a square's bishop and rook entries share a cache line.
+// BBMagicAttacks may move to huge pages or a table file during init, so
+// read it afresh rather than keeping a copy.
+struct BBMagicEntry {
+    uint64_t Mask;
+    uint64_t Magic;
+    uint32_t Offset;
+    uint32_t Shift;
+} __attribute__((aligned(32)));
+
+struct BBMagicSquare {
+    struct BBMagicEntry Bishop;
+    struct BBMagicEntry Rook;
+} __attribute__((aligned(64)));
+
+struct BBMagicTable {
+    struct BBMagicSquare Square[64];
+};
+
+extern const struct BBMagicTable BBMagic;
+extern const uint64_t* BBMagicAttacks;
+
+// The shifts of the library's magics, the same on every square. With a
+// variable-shift set from tools/magics.cpp, define both as 0 when building
+// the library and its users, and lookups take the shift from the entry
+// instead; magic.cpp checks that these match its magics.
+#ifndef BBATTACK_MAGIC_BISHOP_SHIFT
+#define BBATTACK_MAGIC_BISHOP_SHIFT 55
+#endif
+
+#ifndef BBATTACK_MAGIC_ROOK_SHIFT
+#define BBATTACK_MAGIC_ROOK_SHIFT 52
+#endif
+
+#if defined(BBATTACK_INLINE) && !defined(BBATTACK_BUILDING_LIBRARY)
+// A constant shift folds into an immediate.
+static inline unsigned int BBMagicIndex(const struct BBMagicEntry* const entry, const unsigned int shift, const uint64_t occupancy)
 {
-    return BBAttackBishop(occupancy, square) | BBAttackRook(occupancy, square);
+    return entry->Offset + (((occupancy & entry->Mask) * entry->Magic) >> (shift != 0 ? shift : entry->Shift));
+}
+
+// An acquire load, which is a plain one on x86 (see magic.cpp).
+static inline const uint64_t* BBMagicAttackTable()
+{
+    return __atomic_load_n(&BBMagicAttacks, __ATOMIC_ACQUIRE);
+}
+
+static inline uint64_t BBAttackBishop(const uint64_t occupancy, const unsigned int square)
+{
+    return BBMagicAttackTable()[BBMagicIndex(&BBMagic.Square[square].Bishop, BBATTACK_MAGIC_BISHOP_SHIFT, occupancy)];
+}
+
+static inline uint64_t BBAttackRook(const uint64_t occupancy, const unsigned int square)
+{
+    return BBMagicAttackTable()[BBMagicIndex(&BBMagic.Square[square].Rook, BBATTACK_MAGIC_ROOK_SHIFT, occupancy)];
+}
+
+static inline uint64_t BBAttackQueen(const uint64_t occupancy, const unsigned int square)
+{
+    const uint64_t* const attacks = BBMagicAttackTable();
+    const unsigned int bishop = BBMagicIndex(&BBMagic.Square[square].Bishop, BBATTACK_MAGIC_BISHOP_SHIFT, occupancy);
+    const unsigned int rook = BBMagicIndex(&BBMagic.Square[square].Rook, BBATTACK_MAGIC_ROOK_SHIFT, occupancy);
+
+    return attacks[bishop] | attacks[rook];
+}
+
+static inline uint64_t BBXrayBishop(const uint64_t occupancy, const uint64_t blockers, const unsigned int square)
+{
+    const uint64_t attacks = BBAttackBishop(occupancy, square);
+
+    return attacks ^ BBAttackBishop(occupancy & ~(attacks & blockers), square);
+}
+
+static inline uint64_t BBXrayRook(const uint64_t occupancy, const uint64_t blockers, const unsigned int square)
+{
+    const uint64_t attacks = BBAttackRook(occupancy, square);
+
+    return attacks ^ BBAttackRook(occupancy & ~(attacks & blockers), square);
 }
+#endif // #if defined(BBATTACK_INLINE) && !defined(BBATTACK_BUILDING_LIBRARY)
 
 #ifdef __cplusplus
 }
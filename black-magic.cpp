@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+namespace BlackMagic {
+
+// Black magic bitboards, after Onno Garms and Niklas Fiekas: set every bit
+// outside the mask instead of clearing it before the multiply. The key for
+// an empty board is then ~mask rather than zero, so the carries land in more
+// places, which gives the search more ways to make sub-tables overlap and
+// otherwise costs the same single multiply. magic-black-tables.h is the
+// published set in magic-black.h with the attack table ready made, so it
+// ends up in .rodata like magic.cpp's.
+#include "magic-black-tables.h"
+
+// As in magic.cpp, everything but the attack table for one square sits in
+// one cache line. The mask is stored already negated, so a lookup is an OR
+// and a multiply.
+struct Entry {
+    uint64_t NotMask;
+    uint64_t Magic;
+    uint32_t Offset;
+} __attribute__((aligned(32)));
+
+struct SquareEntries {
+    Entry Bishop;
+    Entry Rook;
+} __attribute__((aligned(64)));
+
+static_assert(sizeof(SquareEntries) == 64, "A square's entries should fill one cache line");
+
+struct Entries {
+    SquareEntries Square[64];
+};
+
+static constexpr Entries GenEntries()
+{
+    Entries t = {};
+    int sq = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        t.Square[sq].Bishop = { ~CalcBishopMask(sq), BishopMagic[sq], BishopOffset[sq] };
+        t.Square[sq].Rook = { ~CalcRookMask(sq), RookMagic[sq], RookOffset[sq] };
+    }
+
+    return t;
+}
+
+static constexpr Entries BlackMagic = GenEntries();
+
+static constexpr const uint64_t (&AttackTable)[MagicTableSize] = MagicAttacks;
+
+// As in magic.cpp, Init() and Adopt() may move the attacks while other
+// threads look things up.
+static const uint64_t* AttackPointer = AttackTable;
+
+static const uint64_t* Attacks()
+{
+    return __atomic_load_n(&AttackPointer, __ATOMIC_ACQUIRE);
+}
+
+static inline unsigned int Index(const Entry& entry, const unsigned int shift, const uint64_t occ)
+{
+    return entry.Offset + (((occ | entry.NotMask) * entry.Magic) >> shift);
+}
+
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
+{
+    return Attacks()[Index(BlackMagic.Square[sq].Bishop, BishopShift, occ)];
+}
+
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
+{
+    return Attacks()[Index(BlackMagic.Square[sq].Rook, RookShift, occ)];
+}
+
+// As in magic.cpp, both indices first so the loads overlap.
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    const SquareEntries& entries = BlackMagic.Square[sq];
+    const unsigned int bishop = Index(entries.Bishop, BishopShift, occ);
+    const unsigned int rook = Index(entries.Rook, RookShift, occ);
+
+    const uint64_t* const attacks = Attacks();
+
+    return attacks[bishop] | attacks[rook];
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Bishop>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Rook>(occ, blockers, sq);
+}
+
+// The huge-page copy is opt-in, as in magic.cpp.
+void Init()
+{
+    if (TableCopyWanted() && Attacks() == AttackTable) {
+        uint64_t* copy = (uint64_t*)TableAlloc(sizeof(AttackTable), false);
+        const uint64_t* expected = AttackTable;
+
+        if (copy != nullptr) {
+            memcpy(copy, AttackTable, sizeof(AttackTable));
+
+            if (!__atomic_compare_exchange_n(&AttackPointer, &expected, copy, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                TableFree(copy, sizeof(AttackTable));
+            }
+        }
+    }
+}
+
+// For table files.
+void Image(TableImage* image)
+{
+    uint64_t hash = TableHash(MagicTableSize);
+
+    hash = TableHash(BishopMagic, TableHash(RookMagic, hash));
+    hash = TableHash(BishopShift, TableHash(RookShift, hash));
+    hash = TableHash(BishopOffset, TableHash(RookOffset, hash));
+
+    image->Hash = hash;
+    image->Data = Attacks();
+    image->Size = sizeof(AttackTable);
+    image->BishopOffset = BishopOffset;
+    image->RookOffset = RookOffset;
+}
+
+void Adopt(const void* data)
+{
+    __atomic_store_n(&AttackPointer, (const uint64_t*)data, __ATOMIC_RELEASE);
+}
+}
+
+const Backend BlackMagicBackend = {
+    "black-magic", BlackMagic::Init, BlackMagic::Bishop, BlackMagic::Rook, BlackMagic::Queen,
+    BlackMagic::XrayBishop, BlackMagic::XrayRook, nullptr, nullptr, nullptr
+};
+
+const TableSource BlackMagicTableSource = {
+    "black-magic", 2, BlackMagic::Image, BlackMagic::Adopt
+};
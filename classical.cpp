@@ -26,14 +26,11 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "bbattack.h"
-
-#ifdef USE_CLASSICAL
-
 #include "bbattack-private.h"
 
+namespace Classical {
 namespace {
-    uint64_t ClassicalAttacks[64][8];
+    alignas(64) uint64_t ClassicalAttacks[64][8];
 
     uint64_t LSB(uint64_t x)
     {
@@ -56,10 +53,19 @@ namespace {
             return attacks & ~ClassicalAttacks[MSB(blocker | 1ULL)][dir];
         }
     }
+
+    // The first blocker is already known here, so carry on from it to the
+    // next one. With no blocker, the sentinel square has an empty ray.
+    template<Direction dir> uint64_t ClassicalXray(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+    {
+        const uint64_t attacks = ClassicalAttacks[sq][dir];
+        const unsigned int first = DirShift[dir] > 0 ? LSB((attacks & occ) | (1ULL << 63)) : MSB((attacks & occ) | 1ULL);
+
+        return Classical<dir>(occ, first) & -((blockers >> first) & 1);
+    }
 }
 
-extern "C" {
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     return Classical<Northeast>(occ, sq) |
         Classical<Southeast>(occ, sq) |
@@ -67,7 +73,7 @@ uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
         Classical<Northwest>(occ, sq);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     return Classical<North>(occ, sq) |
         Classical<East>(occ, sq) |
@@ -75,7 +81,35 @@ uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
         Classical<West>(occ, sq);
 }
 
-void BBAttackInit()
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    return Classical<North>(occ, sq) |
+        Classical<East>(occ, sq) |
+        Classical<South>(occ, sq) |
+        Classical<West>(occ, sq) |
+        Classical<Northeast>(occ, sq) |
+        Classical<Southeast>(occ, sq) |
+        Classical<Southwest>(occ, sq) |
+        Classical<Northwest>(occ, sq);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return ClassicalXray<Northeast>(occ, blockers, sq) |
+        ClassicalXray<Southeast>(occ, blockers, sq) |
+        ClassicalXray<Southwest>(occ, blockers, sq) |
+        ClassicalXray<Northwest>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return ClassicalXray<North>(occ, blockers, sq) |
+        ClassicalXray<East>(occ, blockers, sq) |
+        ClassicalXray<South>(occ, blockers, sq) |
+        ClassicalXray<West>(occ, blockers, sq);
+}
+
+void Init()
 {
     int sq;
 
@@ -92,4 +126,7 @@ void BBAttackInit()
 }
 }
 
-#endif // #ifdef USE_CLASSICAL
+const Backend ClassicalBackend = {
+    "classical", Classical::Init, Classical::Bishop, Classical::Rook, Classical::Queen,
+    Classical::XrayBishop, Classical::XrayRook, nullptr, nullptr, nullptr
+};
@@ -22,12 +22,10 @@
  * SOFTWARE.
  */
 
-#include "bbattack.h"
-
-#ifdef USE_DUMB7FILL
-
 #include "bbattack-private.h"
 
+namespace Dumb7Fill {
+
 template<Direction dir>
 uint64_t Dumb7Fill(uint64_t empty, uint64_t fill)
 {
@@ -46,9 +44,14 @@ uint64_t Dumb7Fill(uint64_t empty, uint64_t fill)
     return          Shift<shift>(flood) & mask;
 }
 
-extern "C" {
+// Fill on from whichever first blockers are in blockers.
+template<Direction dir>
+uint64_t Dumb7FillXray(const uint64_t empty, const uint64_t blockers, const uint64_t fill)
+{
+    return Dumb7Fill<dir>(empty, Dumb7Fill<dir>(empty, fill) & blockers & ~empty);
+}
 
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     uint64_t empty = ~occ;
     uint64_t bishop = 1ULL << sq;
@@ -58,7 +61,7 @@ uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
            Dumb7Fill<Direction::Southwest>(empty, bishop);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     uint64_t empty = ~occ;
     uint64_t rook = 1ULL << sq;
@@ -68,10 +71,47 @@ uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
            Dumb7Fill<Direction::West >(empty, rook);
 }
 
-void BBAttackInit()
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t queen = 1ULL << sq;
+    return Dumb7Fill<Direction::North>(empty, queen) |
+           Dumb7Fill<Direction::South>(empty, queen) |
+           Dumb7Fill<Direction::East >(empty, queen) |
+           Dumb7Fill<Direction::West >(empty, queen) |
+           Dumb7Fill<Direction::Northeast>(empty, queen) |
+           Dumb7Fill<Direction::Northwest>(empty, queen) |
+           Dumb7Fill<Direction::Southeast>(empty, queen) |
+           Dumb7Fill<Direction::Southwest>(empty, queen);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t bishop = 1ULL << sq;
+    return Dumb7FillXray<Direction::Northeast>(empty, blockers, bishop) |
+           Dumb7FillXray<Direction::Northwest>(empty, blockers, bishop) |
+           Dumb7FillXray<Direction::Southeast>(empty, blockers, bishop) |
+           Dumb7FillXray<Direction::Southwest>(empty, blockers, bishop);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t rook = 1ULL << sq;
+    return Dumb7FillXray<Direction::North>(empty, blockers, rook) |
+           Dumb7FillXray<Direction::South>(empty, blockers, rook) |
+           Dumb7FillXray<Direction::East >(empty, blockers, rook) |
+           Dumb7FillXray<Direction::West >(empty, blockers, rook);
+}
+
+void Init()
 {
     // No-op.
 }
 }
 
-#endif // #ifdef USE_DUMB7FILL
+const Backend Dumb7FillBackend = {
+    "dumb7fill", Dumb7Fill::Init, Dumb7Fill::Bishop, Dumb7Fill::Rook, Dumb7Fill::Queen,
+    Dumb7Fill::XrayBishop, Dumb7Fill::XrayRook, nullptr, nullptr, nullptr
+};
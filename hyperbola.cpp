@@ -26,20 +26,24 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "bbattack.h"
-
-#ifdef USE_HYPERBOLA
+#include <mutex>
 
 #include "bbattack-private.h"
 
-static struct {
+#ifdef BBATTACK_X86_TARGETS
+#include <immintrin.h>
+#endif
+
+namespace Hyperbola {
+
+alignas(64) static struct {
     uint64_t DiagMask;
     uint64_t AntiDiagMask;
     uint64_t FileMask;
     uint64_t RankMask;
 } HyperbolaMasks[64];
 
-uint8_t RankAttacks[64*8];
+alignas(64) uint8_t RankAttacks[64*8];
 
 namespace Detail {
     enum MaskType {
@@ -52,19 +56,19 @@ namespace Detail {
 
     template<> uint64_t Mask<MaskType::Diagonal>(const unsigned int sq)
     {
-        assert(sq >= 0 && sq <= 63);
+        assert(sq <= 63);
         return HyperbolaMasks[sq].DiagMask;
     }
 
     template<> uint64_t Mask<MaskType::Antidiagonal>(const unsigned int sq)
     {
-        assert(sq >= 0 && sq <= 63);
+        assert(sq <= 63);
         return HyperbolaMasks[sq].AntiDiagMask;
     }
 
     template<> uint64_t Mask<MaskType::File>(const unsigned int sq)
     {
-        assert(sq >= 0 && sq <= 63);
+        assert(sq <= 63);
         return HyperbolaMasks[sq].FileMask;
     }
 
@@ -86,22 +90,60 @@ namespace Detail {
         uint64_t attacks = RankAttacks[4*occbyte + file];
         return attacks << rank;
     }
+
+    // Lift the blockers it found off the line and go again; both passes
+    // use the same mask.
+    template<MaskType type> uint64_t HyperbolaXray(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+    {
+        const uint64_t attacks = Hyperbola<type>(occ, sq);
+
+        return attacks ^ Hyperbola<type>(occ & ~(attacks & blockers), sq);
+    }
+
+    uint64_t GetRankXray(const uint64_t occ, const uint64_t blockers, const int sq)
+    {
+        const uint64_t attacks = GetRankAttacks(occ, sq);
+
+        return attacks ^ GetRankAttacks(occ & ~(attacks & blockers), sq);
+    }
 }
 
-extern "C" {
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     return Detail::Hyperbola<Detail::MaskType::Diagonal>(occ, sq) | 
         Detail::Hyperbola<Detail::MaskType::Antidiagonal>(occ, sq);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     return Detail::GetRankAttacks(occ, sq) | 
         Detail::Hyperbola<Detail::MaskType::File>(occ, sq);
 }
 
-void BBAttackInit()
+// All three line masks come out of the same HyperbolaMasks[sq] entry.
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    return Detail::Hyperbola<Detail::MaskType::Diagonal>(occ, sq) |
+        Detail::Hyperbola<Detail::MaskType::Antidiagonal>(occ, sq) |
+        Detail::Hyperbola<Detail::MaskType::File>(occ, sq) |
+        Detail::GetRankAttacks(occ, sq);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Detail::HyperbolaXray<Detail::MaskType::Diagonal>(occ, blockers, sq) |
+        Detail::HyperbolaXray<Detail::MaskType::Antidiagonal>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Detail::GetRankXray(occ, blockers, sq) |
+        Detail::HyperbolaXray<Detail::MaskType::File>(occ, blockers, sq);
+}
+
+static std::once_flag InitOnce;
+
+static void BuildTables()
 {
     int sq, dest;
 
@@ -136,6 +178,124 @@ void BBAttackInit()
         }
     }
 }
+
+// The vector flavours share the tables, so whichever gets set up first
+// builds them.
+void Init()
+{
+    std::call_once(InitOnce, BuildTables);
+}
+
+#ifdef BBATTACK_X86_TARGETS
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+// The same subtraction for several lines at once, one per 64-bit lane,
+// with PSHUFB doing the byte swap of every lane in one go. The diagonal
+// and anti-diagonal masks sit next to each other in HyperbolaMasks[sq], so
+// one 16-byte load gets both, and one 32-byte load gets the file and rank
+// masks as well.
+SSSE3 static inline __m128i HyperbolaSsse3(const __m128i occ, const __m128i mask, const unsigned int sq)
+{
+    const __m128i swap = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i o = _mm_and_si128(occ, mask);
+    const __m128i r = _mm_shuffle_epi8(o, swap);
+    const __m128i forward = _mm_sub_epi64(o, _mm_set1_epi64x(1ULL << sq));
+    const __m128i reverse = _mm_shuffle_epi8(_mm_sub_epi64(r, _mm_set1_epi64x(1ULL << (sq ^ 56))), swap);
+
+    return _mm_and_si128(_mm_xor_si128(forward, reverse), mask);
+}
+
+SSSE3 static inline uint64_t Combine(const __m128i attacks)
+{
+    return _mm_cvtsi128_si64(_mm_or_si128(attacks, _mm_unpackhi_epi64(attacks, attacks)));
+}
+
+SSSE3 static inline __m128i DiagonalMasks(const unsigned int sq)
+{
+    return _mm_load_si128((const __m128i*)&HyperbolaMasks[sq].DiagMask);
+}
+
+SSSE3 uint64_t BishopSsse3(const uint64_t occ, const unsigned int sq)
+{
+    return Combine(HyperbolaSsse3(_mm_set1_epi64x(occ), DiagonalMasks(sq), sq));
 }
 
-#endif // #ifdef USE_HYPERBOLA
+SSSE3 uint64_t QueenSsse3(const uint64_t occ, const unsigned int sq)
+{
+    return BishopSsse3(occ, sq) | Rook(occ, sq);
+}
+
+// Each lane's second pass only sees its own line, so the blockers can be
+// lifted off all of them at once.
+SSSE3 uint64_t XrayBishopSsse3(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    const __m128i mask = DiagonalMasks(sq);
+    const __m128i o = _mm_set1_epi64x(occ);
+    const __m128i attacks = HyperbolaSsse3(o, mask, sq);
+    const __m128i lifted = _mm_andnot_si128(_mm_and_si128(attacks, _mm_set1_epi64x(blockers)), o);
+
+    return Combine(_mm_xor_si128(attacks, HyperbolaSsse3(lifted, mask, sq)));
+}
+
+bool SupportedSsse3()
+{
+    return __builtin_cpu_supports("ssse3");
+}
+
+// The queen gets the file into the same register, in the third lane. The
+// byte swap doesn't work for ranks, so the fourth lane is masked off and
+// ranks stay with GetRankAttacks().
+AVX2 uint64_t QueenAvx2(const uint64_t occ, const unsigned int sq)
+{
+    const __m256i swap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i mask = _mm256_and_si256(_mm256_load_si256((const __m256i*)&HyperbolaMasks[sq]),
+        _mm256_setr_epi64x(-1, -1, -1, 0));
+    const __m256i o = _mm256_and_si256(_mm256_set1_epi64x(occ), mask);
+    const __m256i r = _mm256_shuffle_epi8(o, swap);
+    const __m256i forward = _mm256_sub_epi64(o, _mm256_set1_epi64x(1ULL << sq));
+    const __m256i reverse = _mm256_shuffle_epi8(_mm256_sub_epi64(r, _mm256_set1_epi64x(1ULL << (sq ^ 56))), swap);
+    const __m256i attacks = _mm256_and_si256(_mm256_xor_si256(forward, reverse), mask);
+
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+
+    return _mm_cvtsi128_si64(half) | Detail::GetRankAttacks(occ, sq);
+}
+
+AVX2 uint64_t BishopAvx2(const uint64_t occ, const unsigned int sq)
+{
+    return BishopSsse3(occ, sq);
+}
+
+AVX2 uint64_t XrayBishopAvx2(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return XrayBishopSsse3(occ, blockers, sq);
+}
+
+bool SupportedAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // #ifdef BBATTACK_X86_TARGETS
+}
+
+const Backend HyperbolaBackend = {
+    "hyperbola", Hyperbola::Init, Hyperbola::Bishop, Hyperbola::Rook, Hyperbola::Queen,
+    Hyperbola::XrayBishop, Hyperbola::XrayRook, nullptr, nullptr, nullptr
+};
+
+#ifdef BBATTACK_X86_TARGETS
+const Backend HyperbolaSsse3Backend = {
+    "hyperbola-ssse3", Hyperbola::Init, Hyperbola::BishopSsse3, Hyperbola::Rook, Hyperbola::QueenSsse3,
+    Hyperbola::XrayBishopSsse3, Hyperbola::XrayRook, Hyperbola::SupportedSsse3, nullptr, nullptr
+};
+
+const Backend HyperbolaAvx2Backend = {
+    "hyperbola-avx2", Hyperbola::Init, Hyperbola::BishopAvx2, Hyperbola::Rook, Hyperbola::QueenAvx2,
+    Hyperbola::XrayBishopAvx2, Hyperbola::XrayRook, Hyperbola::SupportedAvx2, nullptr, nullptr
+};
+#endif
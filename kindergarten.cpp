@@ -0,0 +1,140 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdint.h>
+
+#include "bbattack-private.h"
+
+namespace Kindergarten {
+
+// Gerd Isenberg's kindergarten bitboards. A line with at most one square
+// per file (a rank or either diagonal through sq) collapses onto the top
+// six bits with one multiply by the B-file, which gives the occupancy of
+// files b to g, the only ones that can block. FillUp[occ][file] is the
+// rank attack set for that occupancy copied onto all eight ranks, so ANDing
+// with the line mask puts it back where it came from. Files go the same
+// way through the A-file and a multiply by the c2-h7 diagonal, with their
+// own table.
+//
+// Both tables are 4K and built by the compiler, so there's nothing to set
+// up and nothing to miss in L1 once they're warm.
+static constexpr uint64_t AFile = 0x0101010101010101ULL;
+static constexpr uint64_t BFile = 0x0202020202020202ULL;
+static constexpr uint64_t C2H7Diagonal = 0x0080402010080400ULL;
+
+struct KindergartenTables {
+    uint64_t FillUp[64][8];
+    uint64_t AFileAttacks[64][8];
+
+    struct {
+        uint64_t DiagMask;
+        uint64_t AntiDiagMask;
+        uint64_t RankMask;
+    } Masks[64];
+};
+
+static constexpr unsigned int FileIndex(const uint64_t occ, const unsigned int file)
+{
+    return (((occ >> file) & AFile) * C2H7Diagonal) >> 58;
+}
+
+static constexpr KindergartenTables GenTables()
+{
+    KindergartenTables t = {};
+    uint64_t b = 0;
+    int sq = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        t.Masks[sq].DiagMask = GenMask<Northeast, false>(sq) | GenMask<Southwest, false>(sq);
+        t.Masks[sq].AntiDiagMask = GenMask<Northwest, false>(sq) | GenMask<Southeast, false>(sq);
+        t.Masks[sq].RankMask = GenMask<East, false>(sq) | GenMask<West, false>(sq);
+    }
+
+    // The first rank and the A-file stand in for all the others.
+    for (sq = 0; sq < 8; sq++) {
+        b = 0;
+
+        do {
+            t.FillUp[(b >> 1) & 63][sq] = (CalcRookAttacks(sq, b) & 0xFF) * AFile;
+        } while ((b = SNOOB(t.Masks[sq].RankMask & 0x7E, b)));
+
+        b = 0;
+
+        do {
+            t.AFileAttacks[FileIndex(b, 0)][sq] = CalcRookAttacks(sq * 8, b) & AFile;
+        } while ((b = SNOOB(AFile & 0x00FFFFFFFFFFFF00ULL, b)));
+    }
+
+    return t;
+}
+
+alignas(64) static constexpr KindergartenTables Tables = GenTables();
+
+static inline uint64_t Line(const uint64_t occ, const uint64_t mask, const unsigned int sq)
+{
+    return mask & Tables.FillUp[((occ & mask) * BFile) >> 58][sq & 7];
+}
+
+static inline uint64_t File(const uint64_t occ, const unsigned int sq)
+{
+    return Tables.AFileAttacks[FileIndex(occ, sq & 7)][sq >> 3] << (sq & 7);
+}
+
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
+{
+    return Line(occ, Tables.Masks[sq].DiagMask, sq) | Line(occ, Tables.Masks[sq].AntiDiagMask, sq);
+}
+
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
+{
+    return Line(occ, Tables.Masks[sq].RankMask, sq) | File(occ, sq);
+}
+
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    return Line(occ, Tables.Masks[sq].DiagMask, sq) | Line(occ, Tables.Masks[sq].AntiDiagMask, sq) |
+        Line(occ, Tables.Masks[sq].RankMask, sq) | File(occ, sq);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Bishop>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Rook>(occ, blockers, sq);
+}
+
+void Init()
+{
+    // No-op.
+}
+}
+
+const Backend KindergartenBackend = {
+    "kindergarten", Kindergarten::Init, Kindergarten::Bishop, Kindergarten::Rook, Kindergarten::Queen,
+    Kindergarten::XrayBishop, Kindergarten::XrayRook, nullptr, nullptr, nullptr
+};
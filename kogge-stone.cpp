@@ -22,30 +22,22 @@
  * SOFTWARE.
  */
 
-#include "bbattack.h"
+#include "bbattack-private.h"
 
-#ifdef USE_KOGGE_STONE
+#ifdef BBATTACK_X86_TARGETS
+#include <immintrin.h>
+#endif
 
-#include "bbattack-private.h"
+namespace KoggeStone {
 
-template<int dir>
-uint64_t KoggeStone(uint64_t empty, uint64_t fill)
+// Fill on from whichever first blockers are in blockers.
+template<Direction dir>
+uint64_t KoggeStoneXray(const uint64_t empty, const uint64_t blockers, const uint64_t fill)
 {
-    static_assert(dir >= 0 && dir <= 7, "Direction out of range");
-    constexpr int shift = DirShift[dir];
-    constexpr uint64_t mask = DirMask[dir];
-    empty &= mask;
-    fill |= empty & Shift<shift  >(fill);
-    empty = empty & Shift<shift  >(empty);
-    fill |= empty & Shift<shift*2>(fill);
-    empty = empty & Shift<shift*2>(empty);
-    fill |= empty & Shift<shift*4>(fill);
-    return  mask  & Shift<shift  >(fill);
+    return KoggeStone<dir>(empty, KoggeStone<dir>(empty, fill) & blockers & ~empty);
 }
 
-extern "C" {
-
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     uint64_t empty = ~occ;
     uint64_t bishop = 1ULL << sq;
@@ -55,7 +47,7 @@ uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
            KoggeStone<Direction::Southwest>(empty, bishop);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     uint64_t empty = ~occ;
     uint64_t rook = 1ULL << sq;
@@ -65,10 +57,150 @@ uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
            KoggeStone<Direction::West >(empty, rook);
 }
 
-void BBAttackInit()
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t queen = 1ULL << sq;
+    return KoggeStone<Direction::North>(empty, queen) |
+           KoggeStone<Direction::South>(empty, queen) |
+           KoggeStone<Direction::East >(empty, queen) |
+           KoggeStone<Direction::West >(empty, queen) |
+           KoggeStone<Direction::Northeast>(empty, queen) |
+           KoggeStone<Direction::Northwest>(empty, queen) |
+           KoggeStone<Direction::Southeast>(empty, queen) |
+           KoggeStone<Direction::Southwest>(empty, queen);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t bishop = 1ULL << sq;
+    return KoggeStoneXray<Direction::Northeast>(empty, blockers, bishop) |
+           KoggeStoneXray<Direction::Northwest>(empty, blockers, bishop) |
+           KoggeStoneXray<Direction::Southeast>(empty, blockers, bishop) |
+           KoggeStoneXray<Direction::Southwest>(empty, blockers, bishop);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    uint64_t empty = ~occ;
+    uint64_t rook = 1ULL << sq;
+    return KoggeStoneXray<Direction::North>(empty, blockers, rook) |
+           KoggeStoneXray<Direction::South>(empty, blockers, rook) |
+           KoggeStoneXray<Direction::East >(empty, blockers, rook) |
+           KoggeStoneXray<Direction::West >(empty, blockers, rook);
+}
+
+void Init()
 {
     // No-op.
 }
+
+#ifdef BBATTACK_X86_TARGETS
+
+#define AVX2 __attribute__((target("avx2")))
+
+// The same fill for a single piece, but with its four directions side by
+// side in the lanes of one AVX2 register. Lanes shift by different amounts
+// and some go left while others go right, so every step does a variable
+// left shift and a variable right shift, with a count of 64 (which gives
+// zero) in the lanes that go the other way.
+constexpr long long LeftShift(const Direction dir, const int steps)
+{
+    return DirShift[dir] > 0 ? DirShift[dir] * steps : 64;
+}
+
+constexpr long long RightShift(const Direction dir, const int steps)
+{
+    return DirShift[dir] < 0 ? -DirShift[dir] * steps : 64;
+}
+
+template<Direction a, Direction b, Direction c, Direction d>
+AVX2 __m256i KoggeStoneAvx2(const uint64_t occ, __m256i fill)
+{
+    const __m256i mask = _mm256_setr_epi64x(DirMask[a], DirMask[b], DirMask[c], DirMask[d]);
+
+    const __m256i left1 = _mm256_setr_epi64x(LeftShift(a, 1), LeftShift(b, 1), LeftShift(c, 1), LeftShift(d, 1));
+    const __m256i left2 = _mm256_setr_epi64x(LeftShift(a, 2), LeftShift(b, 2), LeftShift(c, 2), LeftShift(d, 2));
+    const __m256i left4 = _mm256_setr_epi64x(LeftShift(a, 4), LeftShift(b, 4), LeftShift(c, 4), LeftShift(d, 4));
+
+    const __m256i right1 = _mm256_setr_epi64x(RightShift(a, 1), RightShift(b, 1), RightShift(c, 1), RightShift(d, 1));
+    const __m256i right2 = _mm256_setr_epi64x(RightShift(a, 2), RightShift(b, 2), RightShift(c, 2), RightShift(d, 2));
+    const __m256i right4 = _mm256_setr_epi64x(RightShift(a, 4), RightShift(b, 4), RightShift(c, 4), RightShift(d, 4));
+
+    __m256i empty = _mm256_and_si256(_mm256_set1_epi64x(~occ), mask);
+
+    fill = _mm256_or_si256(fill, _mm256_and_si256(empty, _mm256_or_si256(_mm256_sllv_epi64(fill, left1), _mm256_srlv_epi64(fill, right1))));
+    empty = _mm256_and_si256(empty, _mm256_or_si256(_mm256_sllv_epi64(empty, left1), _mm256_srlv_epi64(empty, right1)));
+    fill = _mm256_or_si256(fill, _mm256_and_si256(empty, _mm256_or_si256(_mm256_sllv_epi64(fill, left2), _mm256_srlv_epi64(fill, right2))));
+    empty = _mm256_and_si256(empty, _mm256_or_si256(_mm256_sllv_epi64(empty, left2), _mm256_srlv_epi64(empty, right2)));
+    fill = _mm256_or_si256(fill, _mm256_and_si256(empty, _mm256_or_si256(_mm256_sllv_epi64(fill, left4), _mm256_srlv_epi64(fill, right4))));
+    return _mm256_and_si256(mask, _mm256_or_si256(_mm256_sllv_epi64(fill, left1), _mm256_srlv_epi64(fill, right1)));
+}
+
+// Horizontal OR of the four directions.
+AVX2 uint64_t Combine(const __m256i fill)
+{
+    __m128i attacks = _mm_or_si128(_mm256_castsi256_si128(fill), _mm256_extracti128_si256(fill, 1));
+    attacks = _mm_or_si128(attacks, _mm_unpackhi_epi64(attacks, attacks));
+
+    return _mm_cvtsi128_si64(attacks);
+}
+
+AVX2 uint64_t BishopAvx2(const uint64_t occ, const unsigned int sq)
+{
+    return Combine(KoggeStoneAvx2<Northeast, Northwest, Southeast, Southwest>(occ, _mm256_set1_epi64x(1ULL << sq)));
+}
+
+AVX2 uint64_t RookAvx2(const uint64_t occ, const unsigned int sq)
+{
+    return Combine(KoggeStoneAvx2<North, South, East, West>(occ, _mm256_set1_epi64x(1ULL << sq)));
+}
+
+// Both sets of four directions, ORed lane by lane before the one
+// horizontal step.
+AVX2 uint64_t QueenAvx2(const uint64_t occ, const unsigned int sq)
+{
+    return Combine(_mm256_or_si256(KoggeStoneAvx2<Northeast, Northwest, Southeast, Southwest>(occ, _mm256_set1_epi64x(1ULL << sq)),
+        KoggeStoneAvx2<North, South, East, West>(occ, _mm256_set1_epi64x(1ULL << sq))));
+}
+
+// The first pass leaves the first blocker of each direction in its lane,
+// so the second pass can fill on from there without any shuffling.
+template<Direction a, Direction b, Direction c, Direction d>
+AVX2 uint64_t KoggeStoneXrayAvx2(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    const __m256i first = KoggeStoneAvx2<a, b, c, d>(occ, _mm256_set1_epi64x(1ULL << sq));
+
+    return Combine(KoggeStoneAvx2<a, b, c, d>(occ, _mm256_and_si256(first, _mm256_set1_epi64x(blockers & occ))));
+}
+
+AVX2 uint64_t XrayBishopAvx2(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return KoggeStoneXrayAvx2<Northeast, Northwest, Southeast, Southwest>(occ, blockers, sq);
 }
 
-#endif // #ifdef USE_KOGGE_STONE
+AVX2 uint64_t XrayRookAvx2(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return KoggeStoneXrayAvx2<North, South, East, West>(occ, blockers, sq);
+}
+
+bool SupportedAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // #ifdef BBATTACK_X86_TARGETS
+}
+
+const Backend KoggeStoneBackend = {
+    "kogge-stone", KoggeStone::Init, KoggeStone::Bishop, KoggeStone::Rook, KoggeStone::Queen,
+    KoggeStone::XrayBishop, KoggeStone::XrayRook, nullptr, nullptr, nullptr
+};
+
+#ifdef BBATTACK_X86_TARGETS
+const Backend KoggeStoneAvx2Backend = {
+    "kogge-stone-avx2", KoggeStone::Init, KoggeStone::BishopAvx2, KoggeStone::RookAvx2, KoggeStone::QueenAvx2,
+    KoggeStone::XrayBishopAvx2, KoggeStone::XrayRookAvx2, KoggeStone::SupportedAvx2, nullptr, nullptr
+};
+#endif
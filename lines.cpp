@@ -0,0 +1,128 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+// Between and line tables, and the pin and check masks built on them, for
+// legal move generation. The tables are worked out by the compiler from
+// GenMask(), like the magic tables, so there is nothing to initialise.
+
+namespace Lines {
+
+struct Tables {
+    uint64_t Between[64][64];
+    uint64_t Line[64][64];
+};
+
+// Fill in every pair of squares joined by a ray going dir from sq, along
+// with the line that ray lies on (opposite is the other way along it).
+template<Direction dir, Direction opposite>
+static constexpr void GenRay(Tables& t, const int sq)
+{
+    const uint64_t ray = GenMask<dir, false>(sq);
+    const uint64_t line = ray | GenMask<opposite, false>(sq) | (1ULL << sq);
+    int dest = 0;
+
+    for (dest = 0; dest < 64; dest++) {
+        if (ray & (1ULL << dest)) {
+            t.Between[sq][dest] = ray & ~GenMask<dir, false>(dest) & ~(1ULL << dest);
+            t.Line[sq][dest] = line;
+        }
+    }
+}
+
+static constexpr Tables GenTables()
+{
+    Tables t = {};
+    int sq = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        GenRay<North, South>(t, sq);
+        GenRay<South, North>(t, sq);
+        GenRay<East, West>(t, sq);
+        GenRay<West, East>(t, sq);
+        GenRay<Northeast, Southwest>(t, sq);
+        GenRay<Southwest, Northeast>(t, sq);
+        GenRay<Northwest, Southeast>(t, sq);
+        GenRay<Southeast, Northwest>(t, sq);
+    }
+
+    return t;
+}
+
+static constexpr Tables LineTables = GenTables();
+}
+
+extern "C" {
+uint64_t BBBetween(const unsigned int from, const unsigned int to)
+{
+    return Lines::LineTables.Between[from][to];
+}
+
+uint64_t BBLine(const unsigned int from, const unsigned int to)
+{
+    return Lines::LineTables.Line[from][to];
+}
+
+// A pinner is an enemy slider that the king would see if one of our own
+// pieces were lifted, which is exactly the x-ray the backend gives us; the
+// pinned piece is then whatever of ours sits between the two.
+uint64_t BBPinned(const uint64_t occupancy, const unsigned int king_square, const uint64_t own, const uint64_t enemy_rq, const uint64_t enemy_bq)
+{
+    uint64_t pinners = (BBXrayRook(occupancy, own, king_square) & enemy_rq) |
+        (BBXrayBishop(occupancy, own, king_square) & enemy_bq);
+    uint64_t pinned = 0;
+
+    while (pinners) {
+        pinned |= Lines::LineTables.Between[king_square][__builtin_ctzll(pinners)];
+        pinners &= pinners - 1;
+    }
+
+    return pinned & own;
+}
+
+uint64_t BBCheckers(const uint64_t occupancy, const unsigned int king_square, const uint64_t enemy_rq, const uint64_t enemy_bq)
+{
+    return (BBAttackRook(occupancy, king_square) & enemy_rq) |
+        (BBAttackBishop(occupancy, king_square) & enemy_bq);
+}
+
+uint64_t BBEvasionMask(const unsigned int king_square, const uint64_t checkers)
+{
+    if (checkers == 0) {
+        return ~0ULL;
+    }
+
+    if (checkers & (checkers - 1)) {
+        return 0;
+    }
+
+    return checkers | Lines::LineTables.Between[king_square][__builtin_ctzll(checkers)];
+}
+}
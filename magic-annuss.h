@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAGIC_ANNUSS_H
+#define MAGIC_ANNUSS_H
+
+// Volker Annuss' fixed-shift magics, in the format tools/magics.cpp emits.
+// magic.cpp includes this inside its namespace.
+
+// Using the code kindly provided by Volker Annuss:
+// http://www.talkchess.com/forum/viewtopic.php?topic_view=threads&p=670709&t=60065
+
+static constexpr unsigned int MagicTableSize = 89524; // < 700KB, well done Volker!
+
+static constexpr unsigned int BishopShift = 55;
+static constexpr unsigned int RookShift = 52;
+
+static constexpr uint64_t BishopMagic[64] = {
+    0x404040404040ULL, 0xa060401007fcULL, 0x401020200000ULL, 0x806004000000ULL,
+    0x440200000000ULL, 0x80100800000ULL, 0x104104004000ULL, 0x20020820080ULL,
+    0x40100202004ULL, 0x20080200802ULL, 0x10040080200ULL, 0x8060040000ULL,
+    0x4402000000ULL, 0x21c100b200ULL, 0x400410080ULL, 0x3f7f05fffc0ULL,
+    0x4228040808010ULL, 0x200040404040ULL, 0x400080808080ULL, 0x200200801000ULL,
+    0x240080840000ULL, 0x18000c03fff8ULL, 0xa5840208020ULL, 0x58408404010ULL,
+    0x2022000408020ULL, 0x402000408080ULL, 0x804000810100ULL, 0x100403c0403ffULL,
+    0x78402a8802000ULL, 0x101000804400ULL, 0x80800104100ULL, 0x400480101008ULL,
+    0x1010102004040ULL, 0x808090402020ULL, 0x7fefe08810010ULL, 0x3ff0f833fc080ULL,
+    0x7fe08019003042ULL, 0x202040008040ULL, 0x1004008381008ULL, 0x802003700808ULL,
+    0x208200400080ULL, 0x104100200040ULL, 0x3ffdf7f833fc0ULL, 0x8840450020ULL,
+    0x20040100100ULL, 0x7fffdd80140028ULL, 0x202020200040ULL, 0x1004010039004ULL,
+    0x40041008000ULL, 0x3ffefe0c02200ULL, 0x1010806000ULL, 0x08403000ULL,
+    0x100202000ULL, 0x40100200800ULL, 0x404040404000ULL, 0x6020601803f4ULL,
+    0x3ffdfdfc28048ULL, 0x820820020ULL, 0x10108060ULL, 0x00084030ULL,
+    0x01002020ULL, 0x40408020ULL, 0x4040404040ULL, 0x404040404040ULL
+};
+
+static constexpr unsigned int BishopOffset[64] = {
+    33104, 4094, 24764, 13882,
+    23090, 32640, 11558, 32912,
+    13674, 6109, 26494, 17919,
+    25757, 17338, 16983, 16659,
+    13610, 2224, 60405, 7983,
+    17, 34321, 33216, 17127,
+    6397, 22169, 42727, 155,
+    8601, 21101, 29885, 29340,
+    19785, 12258, 50451, 1712,
+    78475, 7855, 13642, 8156,
+    4348, 28794, 22578, 50315,
+    85452, 32816, 13930, 17967,
+    33200, 32456, 7762, 7794,
+    22761, 14918, 11620, 15925,
+    32528, 12196, 32720, 26781,
+    19817, 24732, 25468, 10186
+};
+
+static constexpr uint64_t RookMagic[64] = {
+    0x280077ffebfffeULL, 0x2004010201097fffULL, 0x10020010053fffULL, 0x30002ff71ffffaULL,
+    0x7fd00441ffffd003ULL, 0x4001d9e03ffff7ULL, 0x4000888847ffffULL, 0x6800fbff75fffdULL,
+    0x28010113ffffULL, 0x20040201fcffffULL, 0x7fe80042ffffe8ULL, 0x1800217fffe8ULL,
+    0x1800073fffe8ULL, 0x7fe8009effffe8ULL, 0x1800602fffe8ULL, 0x30002fffffa0ULL,
+    0x300018010bffffULL, 0x3000c0085fffbULL, 0x4000802010008ULL, 0x2002004002002ULL,
+    0x2002020010002ULL, 0x1002020008001ULL, 0x4040008001ULL, 0x802000200040ULL,
+    0x40200010080010ULL, 0x80010040010ULL, 0x4010008020008ULL, 0x40020200200ULL,
+    0x10020020020ULL, 0x10020200080ULL, 0x8020200040ULL, 0x200020004081ULL,
+    0xfffd1800300030ULL, 0x7fff7fbfd40020ULL, 0x3fffbd00180018ULL, 0x1fffde80180018ULL,
+    0xfffe0bfe80018ULL, 0x1000080202001ULL, 0x3fffbff980180ULL, 0x1fffdff9000e0ULL,
+    0xfffeebfeffd800ULL, 0x7ffff7ffc01400ULL, 0x408104200204ULL, 0x1ffff01fc03000ULL,
+    0xfffe7f8bfe800ULL, 0x8001002020ULL, 0x3fff85fffa804ULL, 0x1fffd75ffa802ULL,
+    0xffffec00280028ULL, 0x7fff75ff7fbfd8ULL, 0x3fff863fbf7fd8ULL, 0x1fffbfdfd7ffd8ULL,
+    0xffff810280028ULL, 0x7ffd7f7feffd8ULL, 0x3fffc0c480048ULL, 0x1ffffafd7ffd8ULL,
+    0xffffe4ffdfa3baULL, 0x7fffef7ff3d3daULL, 0x3fffbfdfeff7faULL, 0x1fffeff7fbfc22ULL,
+    0x20408001001ULL, 0x7fffeffff77fdULL, 0x3ffffbf7dfeecULL, 0x1ffff9dffa333ULL,
+};
+
+static constexpr unsigned int RookOffset[64] = {
+    41305, 14326, 24477, 8223,
+    49795, 60546, 28543, 79282,
+    6457, 4125, 81021, 42341,
+    14139, 19465, 9514, 71090,
+    75419, 33476, 27117, 85964,
+    54915, 36544, 71854, 37996,
+    30398, 55939, 53891, 56963,
+    77451, 12319, 88500, 51405,
+    72878, 676, 83122, 22206,
+    75186, 681, 36453, 20369,
+    1981, 13343, 10650, 57987,
+    26302, 58357, 40546, 0,
+    14967, 80361, 40905, 58347,
+    20381, 81868, 59381, 84404,
+    45811, 62898, 45796, 66994,
+    67204, 32448, 62946, 17005
+};
+
+#endif // #ifndef MAGIC_ANNUSS_H
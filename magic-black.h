@@ -0,0 +1,116 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAGIC_BLACK_H
+#define MAGIC_BLACK_H
+
+// Fixed-shift black magics, in the format tools/magics.cpp emits: the set
+// by Volker Annuss and Niklas Fiekas published on the Chess Programming
+// Wiki's magic bitboards page, whose overlapping sub-tables pack into 87988
+// entries, 1536 fewer than Volker's magics in magic-annuss.h. black-magic.cpp uses them through magic-black-tables.h,
+// which is this with the attack table ready made ("magics -n -t 0 -w").
+
+static constexpr unsigned int MagicTableSize = 87988;
+
+static constexpr unsigned int BishopShift = 55;
+
+static constexpr uint64_t BishopMagic[64] = {
+    0xa7020080601803d8ULL, 0x13802040400801f1ULL, 0xa0080181001f60cULL, 0x1840802004238008ULL,
+    0xc03fe00100000000ULL, 0x24c00bffff400000ULL, 0x808101f40007f04ULL, 0x100808201ec00080ULL,
+    0xffa2feffbfefb7ffULL, 0x83e3ee040080801ULL, 0xc0800080181001f8ULL, 0x440007fe0031000ULL,
+    0x2010007ffc000000ULL, 0x1079ffe000ff8000ULL, 0x3c0708101f400080ULL, 0x80614080fa00040ULL,
+    0x7ffe7fff817fcff9ULL, 0x7ffebfffa01027fdULL, 0x53018080c00f4001ULL, 0x407e0001000ffb8aULL,
+    0x201fe000fff80010ULL, 0xffdfefffde39ffefULL, 0xcc8808000fbf8002ULL, 0x7ff7fbfff8203fffULL,
+    0x8800013e8300c030ULL, 0x420009701806018ULL, 0x7ffeff7f7f01f7fdULL, 0x8700303010c0c006ULL,
+    0xc800181810606000ULL, 0x20002038001c8010ULL, 0x87ff038000fc001ULL, 0x80c0c00083007ULL,
+    0x80fc82c040ULL, 0x407e416020ULL, 0x600203f8008020ULL, 0xd003fefe04404080ULL,
+    0xa00020c018003088ULL, 0x7fbffe700bffe800ULL, 0x107ff00fe4000f90ULL, 0x7f8fffcff1d007f8ULL,
+    0x4100f88080ULL, 0x20807c4040ULL, 0x41018700c0ULL, 0x10000080fc4080ULL,
+    0x1000003c80180030ULL, 0xc10000df80280050ULL, 0xffffffbfeff80fdcULL, 0x101003f812ULL,
+    0x800001f40808200ULL, 0x84000101f3fd208ULL, 0x80000000f808081ULL, 0x4000008003f80ULL,
+    0x8000001001fe040ULL, 0x72dd000040900a00ULL, 0xfffffeffbfeff81dULL, 0xcd8000200febf209ULL,
+    0x100000101ec10082ULL, 0x7fbaffffefe0c02fULL, 0x7f83fffffff07f7fULL, 0xfff1fffffff7ffc1ULL,
+    0x878040000ffe01fULL, 0x945e388000801012ULL, 0x840800080200fdaULL, 0x100000c05f582008ULL
+};
+
+static constexpr unsigned int BishopOffset[64] = {
+    60984, 66046, 32910, 16369,
+    42115, 835, 18910, 25911,
+    63301, 16063, 17481, 59361,
+    18735, 61249, 68938, 61791,
+    21893, 62068, 19829, 26091,
+    15815, 16419, 59777, 16288,
+    33235, 15459, 15863, 75555,
+    79445, 15917, 8512, 73069,
+    16078, 19168, 11056, 62544,
+    80477, 75049, 32947, 59172,
+    55845, 61806, 73601, 15546,
+    45243, 20333, 33402, 25917,
+    32875, 4639, 17077, 62324,
+    18159, 61436, 57073, 61025,
+    81259, 64083, 56114, 57058,
+    58912, 22194, 70880, 11140
+};
+
+static constexpr unsigned int RookShift = 52;
+
+static constexpr uint64_t RookMagic[64] = {
+    0x80280013ff84ffffULL, 0x5ffbfefdfef67fffULL, 0xffeffaffeffdffffULL, 0x3000900300008aULL,
+    0x50028010500023ULL, 0x20012120a00020ULL, 0x30006000c00030ULL, 0x58005806b00002ULL,
+    0x7fbff7fbfbeafffcULL, 0x140081050002ULL, 0x180043800048ULL, 0x7fffe800021fffb8ULL,
+    0xffffcffe7fcfffafULL, 0x1800c0180060ULL, 0x4f8018005fd00018ULL, 0x180030620018ULL,
+    0x300018010c0003ULL, 0x3000c0085ffffULL, 0xfffdfff7fbfefff7ULL, 0x7fc1ffdffc001fffULL,
+    0xfffeffdffdffdfffULL, 0x7c108007befff81fULL, 0x20408007bfe00810ULL, 0x400800558604100ULL,
+    0x40200010080008ULL, 0x10020008040004ULL, 0xfffdfefff7fbfff7ULL, 0xfebf7dfff8fefff9ULL,
+    0xc00000ffe001ffe0ULL, 0x4af01f00078007c3ULL, 0xbffbfafffb683f7fULL, 0x807f67ffa102040ULL,
+    0x200008e800300030ULL, 0x8780180018ULL, 0x10300180018ULL, 0x4000008180180018ULL,
+    0x8080310005fffaULL, 0x4000188100060006ULL, 0xffffff7fffbfbfffULL, 0x802000200040ULL,
+    0x20000202ec002800ULL, 0xfffff9ff7cfff3ffULL, 0x404b801800ULL, 0x2000002fe03fd000ULL,
+    0xffffff6ffe7fcffdULL, 0xbff7efffbfc00fffULL, 0x100800a804ULL, 0x6054000a58005805ULL,
+    0x829000101150028ULL, 0x85008a0014ULL, 0x8000002b00408028ULL, 0x4000002040790028ULL,
+    0x7800002010288028ULL, 0x1800e08018ULL, 0xa3a80003f3a40048ULL, 0x2003d80000500028ULL,
+    0xfffff37eefefdfbeULL, 0x40000280090013c1ULL, 0xbf7ffeffbffaf71fULL, 0xfffdffff777b7d6eULL,
+    0x48300007e8080c02ULL, 0xafe0000fff780402ULL, 0xee73fffbffbb77feULL, 0x2000308482882ULL
+};
+
+static constexpr unsigned int RookOffset[64] = {
+    10890, 50579, 62020, 67322,
+    80251, 58503, 51175, 83130,
+    50430, 21613, 72625, 80755,
+    69753, 26973, 84972, 31958,
+    69272, 48372, 65477, 43972,
+    57154, 53521, 30534, 16548,
+    46407, 11841, 21112, 44214,
+    57925, 29574, 17309, 40143,
+    64659, 70469, 62917, 60997,
+    18554, 14385, 0, 38091,
+    25122, 60083, 72209, 67875,
+    56290, 43807, 73365, 76398,
+    20024, 9513, 24324, 22996,
+    23213, 56002, 22809, 44545,
+    36072, 4750, 6014, 36054,
+    78538, 28745, 8555, 1009
+};
+
+#endif // #ifndef MAGIC_BLACK_H
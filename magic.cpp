@@ -25,230 +25,354 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
-#include "bbattack.h"
-
-#ifdef USE_MAGIC
+#define BBATTACK_BUILDING_LIBRARY
 
+#include "bbattack.h"
 #include "bbattack-private.h"
 
-// Using the code kindly provided by Volker Annuss:
-// http://www.talkchess.com/forum/viewtopic.php?topic_view=threads&p=670709&t=60065
-
-static uint64_t MagicTable[89524]; // < 700KB, well done Volker!
-
-static uint64_t BishopMask[64];
-static uint64_t RookMask[64];
-
-static const uint64_t BishopMagic[64] = {
-    0x404040404040ULL, 0xa060401007fcULL, 0x401020200000ULL, 0x806004000000ULL,
-    0x440200000000ULL, 0x80100800000ULL, 0x104104004000ULL, 0x20020820080ULL,
-    0x40100202004ULL, 0x20080200802ULL, 0x10040080200ULL, 0x8060040000ULL,
-    0x4402000000ULL, 0x21c100b200ULL, 0x400410080ULL, 0x3f7f05fffc0ULL,
-    0x4228040808010ULL, 0x200040404040ULL, 0x400080808080ULL, 0x200200801000ULL,
-    0x240080840000ULL, 0x18000c03fff8ULL, 0xa5840208020ULL, 0x58408404010ULL,
-    0x2022000408020ULL, 0x402000408080ULL, 0x804000810100ULL, 0x100403c0403ffULL,
-    0x78402a8802000ULL, 0x101000804400ULL, 0x80800104100ULL, 0x400480101008ULL,
-    0x1010102004040ULL, 0x808090402020ULL, 0x7fefe08810010ULL, 0x3ff0f833fc080ULL,
-    0x7fe08019003042ULL, 0x202040008040ULL, 0x1004008381008ULL, 0x802003700808ULL,
-    0x208200400080ULL, 0x104100200040ULL, 0x3ffdf7f833fc0ULL, 0x8840450020ULL,
-    0x20040100100ULL, 0x7fffdd80140028ULL, 0x202020200040ULL, 0x1004010039004ULL,
-    0x40041008000ULL, 0x3ffefe0c02200ULL, 0x1010806000ULL, 0x08403000ULL,
-    0x100202000ULL, 0x40100200800ULL, 0x404040404000ULL, 0x6020601803f4ULL,
-    0x3ffdfdfc28048ULL, 0x820820020ULL, 0x10108060ULL, 0x00084030ULL,
-    0x01002020ULL, 0x40408020ULL, 0x4040404040ULL, 0x404040404040ULL
-};
+namespace Magic {
 
-static const uint64_t * BishopOffset[64] = {
-    MagicTable+33104, MagicTable+4094, MagicTable+24764, MagicTable+13882,
-    MagicTable+23090, MagicTable+32640, MagicTable+11558, MagicTable+32912,
-    MagicTable+13674, MagicTable+6109, MagicTable+26494, MagicTable+17919,
-    MagicTable+25757, MagicTable+17338, MagicTable+16983, MagicTable+16659,
-    MagicTable+13610, MagicTable+2224, MagicTable+60405, MagicTable+7983,
-    MagicTable+17, MagicTable+34321, MagicTable+33216, MagicTable+17127,
-    MagicTable+6397, MagicTable+22169, MagicTable+42727, MagicTable+155,
-    MagicTable+8601, MagicTable+21101, MagicTable+29885, MagicTable+29340,
-    MagicTable+19785, MagicTable+12258, MagicTable+50451, MagicTable+1712,
-    MagicTable+78475, MagicTable+7855, MagicTable+13642, MagicTable+8156,
-    MagicTable+4348, MagicTable+28794, MagicTable+22578, MagicTable+50315,
-    MagicTable+85452, MagicTable+32816, MagicTable+13930, MagicTable+17967,
-    MagicTable+33200, MagicTable+32456, MagicTable+7762, MagicTable+7794,
-    MagicTable+22761, MagicTable+14918, MagicTable+11620, MagicTable+15925,
-    MagicTable+32528, MagicTable+12196, MagicTable+32720, MagicTable+26781,
-    MagicTable+19817, MagicTable+24732, MagicTable+25468, MagicTable+10186
-};
+// The magics, shifts and table offsets. Volker's set is the default; define
+// BBATTACK_MAGICS as the name of a header made by tools/magics.cpp to use a
+// different one, say one that trades speed for a smaller table. The shifts
+// can either be one constant per piece or an array with one per square.
+// magic-annuss-tables.h is Volker's set (magic-annuss.h) with the tables
+// below already built, as written by tools/magics.cpp -t 0 -w.
+#ifdef BBATTACK_MAGICS
+#include BBATTACK_MAGICS
+#else
+#include "magic-annuss-tables.h"
+#endif // #ifdef BBATTACK_MAGICS
 
-static const uint64_t RookMagic[64] = {
-    0x280077ffebfffeULL, 0x2004010201097fffULL, 0x10020010053fffULL, 0x30002ff71ffffaULL,
-    0x7fd00441ffffd003ULL, 0x4001d9e03ffff7ULL, 0x4000888847ffffULL, 0x6800fbff75fffdULL,
-    0x28010113ffffULL, 0x20040201fcffffULL, 0x7fe80042ffffe8ULL, 0x1800217fffe8ULL,
-    0x1800073fffe8ULL, 0x7fe8009effffe8ULL, 0x1800602fffe8ULL, 0x30002fffffa0ULL,
-    0x300018010bffffULL, 0x3000c0085fffbULL, 0x4000802010008ULL, 0x2002004002002ULL,
-    0x2002020010002ULL, 0x1002020008001ULL, 0x4040008001ULL, 0x802000200040ULL,
-    0x40200010080010ULL, 0x80010040010ULL, 0x4010008020008ULL, 0x40020200200ULL,
-    0x10020020020ULL, 0x10020200080ULL, 0x8020200040ULL, 0x200020004081ULL,
-    0xfffd1800300030ULL, 0x7fff7fbfd40020ULL, 0x3fffbd00180018ULL, 0x1fffde80180018ULL,
-    0xfffe0bfe80018ULL, 0x1000080202001ULL, 0x3fffbff980180ULL, 0x1fffdff9000e0ULL,
-    0xfffeebfeffd800ULL, 0x7ffff7ffc01400ULL, 0x408104200204ULL, 0x1ffff01fc03000ULL,
-    0xfffe7f8bfe800ULL, 0x8001002020ULL, 0x3fff85fffa804ULL, 0x1fffd75ffa802ULL,
-    0xffffec00280028ULL, 0x7fff75ff7fbfd8ULL, 0x3fff863fbf7fd8ULL, 0x1fffbfdfd7ffd8ULL,
-    0xffff810280028ULL, 0x7ffd7f7feffd8ULL, 0x3fffc0c480048ULL, 0x1ffffafd7ffd8ULL,
-    0xffffe4ffdfa3baULL, 0x7fffef7ff3d3daULL, 0x3fffbfdfeff7faULL, 0x1fffeff7fbfc22ULL,
-    0x20408001001ULL, 0x7fffeffff77fdULL, 0x3ffffbf7dfeecULL, 0x1ffff9dffa333ULL,
-};
+static constexpr unsigned int IndexShift(const unsigned int shift, const unsigned int)
+{
+    return shift;
+}
 
-static const uint64_t * RookOffset[64] = {
-    MagicTable+41305, MagicTable+14326, MagicTable+24477, MagicTable+8223,
-    MagicTable+49795, MagicTable+60546, MagicTable+28543, MagicTable+79282,
-    MagicTable+6457, MagicTable+4125, MagicTable+81021, MagicTable+42341,
-    MagicTable+14139, MagicTable+19465, MagicTable+9514, MagicTable+71090,
-    MagicTable+75419, MagicTable+33476, MagicTable+27117, MagicTable+85964,
-    MagicTable+54915, MagicTable+36544, MagicTable+71854, MagicTable+37996,
-    MagicTable+30398, MagicTable+55939, MagicTable+53891, MagicTable+56963,
-    MagicTable+77451, MagicTable+12319, MagicTable+88500, MagicTable+51405,
-    MagicTable+72878, MagicTable+676, MagicTable+83122, MagicTable+22206,
-    MagicTable+75186, MagicTable+681, MagicTable+36453, MagicTable+20369,
-    MagicTable+1981, MagicTable+13343, MagicTable+10650, MagicTable+57987,
-    MagicTable+26302, MagicTable+58357, MagicTable+40546, MagicTable+0,
-    MagicTable+14967, MagicTable+80361, MagicTable+40905, MagicTable+58347,
-    MagicTable+20381, MagicTable+81868, MagicTable+59381, MagicTable+84404,
-    MagicTable+45811, MagicTable+62898, MagicTable+45796, MagicTable+66994,
-    MagicTable+67204, MagicTable+32448, MagicTable+62946, MagicTable+17005
-};
+static constexpr unsigned int IndexShift(const unsigned int (&shift)[64], const unsigned int sq)
+{
+    return shift[sq];
+}
 
+// Everything a lookup needs besides the attack table, for one piece on one
+// square, is in a BBMagicEntry (see bbattack.h, which exports them for
+// BBATTACK_INLINE). The bishop's and the rook's entries for a square share
+// a cache line, so a cold lookup of either, or of a queen, misses once on
+// the way to the table rather than once per array.
+static_assert(sizeof(BBMagicSquare) == 64, "A square's entries should fill one cache line");
 
-// Steffan Westcott's innovation.
-static uint64_t SNOOB(const uint64_t set, const uint64_t subset)
+// With one shift per piece it stays an immediate; the one in the entry is
+// only read when the shifts vary by square.
+static constexpr unsigned int EntryShift(const unsigned int shift, const BBMagicEntry&)
 {
-    return (subset - set) & set;
+    return shift;
 }
 
-static uint64_t CalcRookMask(int sq)
+static constexpr unsigned int EntryShift(const unsigned int (&)[64], const BBMagicEntry& entry)
 {
-    uint64_t result = 0;
+    return entry.Shift;
+}
 
-    result |= GenMask<North, true>(sq);
-    result |= GenMask<South, true>(sq);
-    result |= GenMask<East,  true>(sq);
-    result |= GenMask<West,  true>(sq);
-   
-    return result;
+static constexpr unsigned int FixedShift(const unsigned int shift)
+{
+    return shift;
 }
 
-static uint64_t CalcBishopMask(int sq)
+static constexpr unsigned int FixedShift(const unsigned int (&)[64])
 {
-    uint64_t result = 0;
-    
-    result |= GenMask<Northeast, true>(sq);
-    result |= GenMask<Southeast, true>(sq);
-    result |= GenMask<Northwest, true>(sq);
-    result |= GenMask<Southwest, true>(sq);
+    return 0;
+}
+
+static_assert(FixedShift(BishopShift) == BBATTACK_MAGIC_BISHOP_SHIFT && FixedShift(RookShift) == BBATTACK_MAGIC_ROOK_SHIFT,
+    "BBATTACK_MAGIC_BISHOP_SHIFT and BBATTACK_MAGIC_ROOK_SHIFT don't match the magics (0 for variable shifts)");
 
-    return result;
+template<typename Shift>
+static inline unsigned int Index(const BBMagicEntry& entry, const Shift& shift, const uint64_t occ)
+{
+    return entry.Offset + (((occ & entry.Mask) * entry.Magic) >> EntryShift(shift, entry));
 }
 
-// Likewise.
-static uint64_t CalcRookAttacks(int sq, uint64_t block)
+// Everything else is worked out by the compiler, so the tables end up in
+// .rodata: Init() has nothing left to do, and every process using the
+// library shares one copy of them through the page cache.
+static constexpr BBMagicTable GenEntries()
 {
-    uint64_t result = 0ULL;
-    int rk = sq/8, fl = sq%8, r, f;
-    for (r = rk+1; r <= 7; r++) {
-        result |= (1ULL << (fl + r*8));
-        if(block & (1ULL << (fl + r*8))) {
-            break;
-        }
-    }
-    for (r = rk-1; r >= 0; r--) {
-        result |= (1ULL << (fl + r*8));
-        if(block & (1ULL << (fl + r*8))) {
-            break;
-        }
-    }
-    for (f = fl+1; f <= 7; f++) {
-        result |= (1ULL << (f + rk*8));
-        if(block & (1ULL << (f + rk*8))) {
-            break;
-        }
-    }
-    for (f = fl-1; f >= 0; f--) {
-        result |= (1ULL << (f + rk*8));
-        if(block & (1ULL << (f + rk*8))) {
-            break;
-        }
+    BBMagicTable t = {};
+    int sq = 0;
+
+    for (sq = 0; sq < 64; sq++) {
+        t.Square[sq].Bishop = { CalcBishopMask(sq), BishopMagic[sq], BishopOffset[sq], IndexShift(BishopShift, sq) };
+        t.Square[sq].Rook = { CalcRookMask(sq), RookMagic[sq], RookOffset[sq], IndexShift(RookShift, sq) };
     }
-    return result;
+
+    return t;
 }
+}
+
+constexpr BBMagicTable BBMagic = Magic::GenEntries();
+
+namespace Magic {
+
+#ifdef BBATTACK_MAGICS_TABLES
+
+// The header came with the tables ready made (tools/magics.cpp -w), which
+// saves the compiler building them; see below.
+static constexpr const uint64_t (&AttackTable)[MagicTableSize] = MagicAttacks;
+
+#else
+
+// Building the tables takes GCC several seconds, and very likely more
+// constant evaluation steps than clang allows by default, so headers
+// without tables may need a bigger -fconstexpr-steps there. The default
+// magics come with their tables (magic-annuss-tables.h), so only other
+// magics pay for this; tools/magics.cpp -w adds the tables to a header.
+struct Tables {
+    uint64_t Attacks[MagicTableSize];
+};
 
-// Likewise. At this point I'll be banned from all ICGA tournaments.
-// Such is the price of laziness.
-static uint64_t CalcBishopAttacks(int sq, uint64_t block)
+static constexpr Tables GenTables()
 {
-    uint64_t result = 0ULL;
-    int rk = sq/8, fl = sq%8, r, f;
-    for(r = rk+1, f = fl+1; r <= 7 && f <= 7; r++, f++) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
-        }
-    }
-    for(r = rk+1, f = fl-1; r <= 7 && f >= 0; r++, f--) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
-        }
-    }
-    for(r = rk-1, f = fl+1; r >= 0 && f <= 7; r--, f++) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
-        }
+    Tables t = {};
+    uint64_t b = 0;
+    int sq = 0;
+
+    // Bishops
+    for (sq = 0; sq < 64; sq++) {
+        b = 0;
+
+        do {
+            t.Attacks[BishopOffset[sq] + ((b * BishopMagic[sq]) >> IndexShift(BishopShift, sq))] = CalcBishopAttacks(sq, b);
+        } while ((b = SNOOB(BBMagic.Square[sq].Bishop.Mask, b)));
     }
-    for(r = rk-1, f = fl-1; r >= 0 && f >= 0; r--, f--) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
-        }
+
+    // Rooks
+    for (sq = 0; sq < 64; sq++) {
+        b = 0;
+
+        do {
+            t.Attacks[RookOffset[sq] + ((b * RookMagic[sq]) >> IndexShift(RookShift, sq))] = CalcRookAttacks(sq, b);
+        } while ((b = SNOOB(BBMagic.Square[sq].Rook.Mask, b)));
     }
-    return result;
-}
 
-extern "C" {
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
-{
-    return *(BishopOffset[sq] + (((occ & BishopMask[sq]) * BishopMagic[sq]) >> 55));
+    return t;
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
-{
-    return *(RookOffset[sq] + (((occ & RookMask[sq]) * RookMagic[sq]) >> 52));
-}
+alignas(64) static constexpr Tables MagicTables = GenTables();
+
+static constexpr const uint64_t (&AttackTable)[MagicTableSize] = MagicTables.Attacks;
+
+#endif // #ifdef BBATTACK_MAGICS_TABLES
+
+// The compressed flavour. Behind the first blocker the occupancy doesn't
+// matter, so most entries above are repeats: a rook on d4 has 1024
+// relevant occupancies but only 3 * 4 * 3 * 4 = 144 different attack sets.
+// Here the magic index picks a 16-bit id instead, into a pool holding each
+// square's distinct attack sets once. Each square gets its own consecutive
+// run of the pool, bishops first, so a set that turns up on two squares is
+// stored twice; that still comes to only 6328 sets, small enough for 16-bit
+// ids, and the whole thing takes about a third of the memory for one more
+// (well cached) load.
+//
+// The sets are numbered with SetId() (see bbattack-private.h).
+static constexpr unsigned int PoolSize = SetPoolSize();
 
-void BBAttackInit()
+static_assert(PoolSize <= 65536, "Attack set ids don't fit in 16 bits");
+
+#ifdef BBATTACK_MAGICS_TABLES
+
+static constexpr const uint16_t (&SetIds)[MagicTableSize] = MagicSetIds;
+static constexpr const uint64_t (&SetPool)[PoolSize] = MagicSetPool;
+
+#else
+
+struct DedupTables {
+    uint16_t Ids[MagicTableSize];
+    uint64_t Pool[PoolSize];
+};
+
+static constexpr DedupTables GenDedupTables()
 {
-    uint64_t b, *index;
-    int sq;
+    DedupTables t = {};
+    uint64_t b = 0, attacks = 0;
+    unsigned int pool = 0, id = 0;
+    int sq = 0;
 
     // Bishops
     for (sq = 0; sq < 64; sq++) {
         b = 0;
-        BishopMask[sq] = CalcBishopMask(sq);
 
         do {
-            index = (uint64_t*)(BishopOffset[sq] + (((b & BishopMask[sq]) * BishopMagic[sq]) >> 55));
-            *index = CalcBishopAttacks(sq, b);
-        } while ((b = SNOOB(BishopMask[sq], b)));
+            attacks = CalcBishopAttacks(sq, b);
+            id = pool + BishopSetId(sq, attacks);
+            t.Ids[BishopOffset[sq] + ((b * BishopMagic[sq]) >> IndexShift(BishopShift, sq))] = id;
+            t.Pool[id] = attacks;
+        } while ((b = SNOOB(BBMagic.Square[sq].Bishop.Mask, b)));
+
+        pool += BishopSetCount(sq);
     }
 
     // Rooks
     for (sq = 0; sq < 64; sq++) {
         b = 0;
-        RookMask[sq] = CalcRookMask(sq);
 
         do {
-            index = (uint64_t*)(RookOffset[sq] + (((b & RookMask[sq]) * RookMagic[sq]) >> 52));
-            *index = CalcRookAttacks(sq, b);
-        } while ((b = SNOOB(RookMask[sq], b)));
+            attacks = CalcRookAttacks(sq, b);
+            id = pool + RookSetId(sq, attacks);
+            t.Ids[RookOffset[sq] + ((b * RookMagic[sq]) >> IndexShift(RookShift, sq))] = id;
+            t.Pool[id] = attacks;
+        } while ((b = SNOOB(BBMagic.Square[sq].Rook.Mask, b)));
+
+        pool += RookSetCount(sq);
     }
+
+    return t;
+}
+
+alignas(64) static constexpr DedupTables Dedup = GenDedupTables();
+
+static constexpr const uint16_t (&SetIds)[MagicTableSize] = Dedup.Ids;
+static constexpr const uint64_t (&SetPool)[PoolSize] = Dedup.Pool;
+
+#endif // #ifdef BBATTACK_MAGICS_TABLES
+}
+
+// Lookups go through this, so that Init() and Adopt() can move the attacks
+// onto huge pages or a table file while other threads look things up. It
+// is stored with release and read with acquire (a plain load on x86); C
+// code reads it too, hence the builtins rather than std::atomic.
+const uint64_t* BBMagicAttacks = Magic::AttackTable;
+
+namespace Magic {
+
+static const uint64_t* Attacks()
+{
+    return __atomic_load_n(&BBMagicAttacks, __ATOMIC_ACQUIRE);
+}
+
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
+{
+    return Attacks()[Index(BBMagic.Square[sq].Bishop, BishopShift, occ)];
+}
+
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
+{
+    return Attacks()[Index(BBMagic.Square[sq].Rook, RookShift, occ)];
+}
+
+// Both entries come in with one line; work out both indices before
+// touching the table, so the two loads can be in flight at once.
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    const BBMagicSquare& entries = BBMagic.Square[sq];
+    const unsigned int bishop = Index(entries.Bishop, BishopShift, occ);
+    const unsigned int rook = Index(entries.Rook, RookShift, occ);
+
+    const uint64_t* const attacks = Attacks();
+
+    return attacks[bishop] | attacks[rook];
 }
+
+uint64_t BishopDedup(const uint64_t occ, const unsigned int sq)
+{
+    return SetPool[SetIds[Index(BBMagic.Square[sq].Bishop, BishopShift, occ)]];
+}
+
+uint64_t RookDedup(const uint64_t occ, const unsigned int sq)
+{
+    return SetPool[SetIds[Index(BBMagic.Square[sq].Rook, RookShift, occ)]];
 }
-#endif // #ifdef USE_MAGIC
+
+uint64_t QueenDedup(const uint64_t occ, const unsigned int sq)
+{
+    const BBMagicSquare& entries = BBMagic.Square[sq];
+    const unsigned int bishop = Index(entries.Bishop, BishopShift, occ);
+    const unsigned int rook = Index(entries.Rook, RookShift, occ);
+
+    return SetPool[SetIds[bishop]] | SetPool[SetIds[rook]];
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Bishop>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Rook>(occ, blockers, sq);
+}
+
+uint64_t XrayBishopDedup(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<BishopDedup>(occ, blockers, sq);
+}
+
+uint64_t XrayRookDedup(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<RookDedup>(occ, blockers, sq);
+}
+
+void InitDedup()
+{
+    // No-op.
+}
+
+// The table in .rodata is shared between processes but sits on small
+// pages. If BBATTACK_HUGE_PAGES=1 asks for it, and huge pages are to be had,
+// swap that for a private copy on them, for a search that would rather pay
+// the memory than the TLB misses. A table mapped from a file is left be:
+// sharing it is what it's for.
+void Init()
+{
+    if (TableCopyWanted() && Attacks() == AttackTable) {
+        uint64_t* copy = (uint64_t*)TableAlloc(sizeof(AttackTable), false);
+        const uint64_t* expected = AttackTable;
+
+        // Only if nobody else published a copy or adopted a table file
+        // while we were copying; if they did, ours was never seen.
+        if (copy != nullptr) {
+            memcpy(copy, AttackTable, sizeof(AttackTable));
+
+            if (!__atomic_compare_exchange_n(&BBMagicAttacks, &expected, copy, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                TableFree(copy, sizeof(AttackTable));
+            }
+        }
+    }
+}
+
+// For table files.
+void Image(TableImage* image)
+{
+    uint64_t hash = TableHash(MagicTableSize);
+
+    hash = TableHash(BishopMagic, TableHash(RookMagic, hash));
+    hash = TableHash(BishopShift, TableHash(RookShift, hash));
+    hash = TableHash(BishopOffset, TableHash(RookOffset, hash));
+
+    image->Hash = hash;
+    image->Data = Attacks();
+    image->Size = sizeof(AttackTable);
+    image->BishopOffset = BishopOffset;
+    image->RookOffset = RookOffset;
+}
+
+void Adopt(const void* data)
+{
+    __atomic_store_n(&BBMagicAttacks, (const uint64_t*)data, __ATOMIC_RELEASE);
+}
+}
+
+const Backend MagicBackend = {
+    "magic", Magic::Init, Magic::Bishop, Magic::Rook, Magic::Queen,
+    Magic::XrayBishop, Magic::XrayRook, nullptr, nullptr, nullptr
+};
+
+const Backend MagicDedupBackend = {
+    "magic-dedup", Magic::InitDedup, Magic::BishopDedup, Magic::RookDedup, Magic::QueenDedup,
+    Magic::XrayBishopDedup, Magic::XrayRookDedup, nullptr, nullptr, nullptr
+};
+
+const TableSource MagicTableSource = {
+    "magic", 1, Magic::Image, Magic::Adopt
+};
@@ -26,13 +26,13 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "bbattack.h"
-
-#ifdef USE_OBSTRUCTION
-
 #include "bbattack-private.h"
 
-static struct {
+namespace Obstruction {
+
+// The four lines of a square fill exactly one 64-byte cache line, so a
+// queen lookup touches a single line.
+alignas(64) static struct {
     uint64_t Upper;
     uint64_t Lower;
 } ObstructionMasks[64][4];
@@ -59,11 +59,6 @@ namespace {
         return ObstructionMasks[sq][type].Lower;
     }
 
-    uint64_t LSB(uint64_t x)
-    {
-        return __builtin_ctzll(x);
-    }
-
     uint64_t MSB(uint64_t x)
     {
         return 63 ^ __builtin_clzll(x);
@@ -81,25 +76,52 @@ namespace {
 
         return (MaskUpper<type>(sq) | MaskLower<type>(sq)) & diff;
     }
+
+    // Lift the blockers it found off the line and go again; both passes
+    // use the same pair of masks.
+    template<MaskType type> uint64_t ObstructionXray(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+    {
+        const uint64_t attacks = Obstruction<type>(occ, sq);
+
+        return attacks ^ Obstruction<type>(occ & ~(attacks & blockers), sq);
+    }
 }
 
-extern "C" {
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     return Obstruction<MaskType::Diagonal>(occ, sq) | 
         Obstruction<MaskType::Antidiagonal>(occ, sq);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     return Obstruction<MaskType::Rank>(occ, sq) |
         Obstruction<MaskType::File>(occ, sq);
 }
 
-void BBAttackInit()
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    return Obstruction<MaskType::Diagonal>(occ, sq) |
+        Obstruction<MaskType::Antidiagonal>(occ, sq) |
+        Obstruction<MaskType::Rank>(occ, sq) |
+        Obstruction<MaskType::File>(occ, sq);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return ObstructionXray<MaskType::Diagonal>(occ, blockers, sq) |
+        ObstructionXray<MaskType::Antidiagonal>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return ObstructionXray<MaskType::Rank>(occ, blockers, sq) |
+        ObstructionXray<MaskType::File>(occ, blockers, sq);
+}
+
+void Init()
 {
-    int sq, dest;
-    uint64_t mask;
+    int sq;
 
     for (sq = 0; sq < 64; sq++) {
 
@@ -118,4 +140,7 @@ void BBAttackInit()
 }
 }
 
-#endif // #ifdef USE_OBSTRUCTION
+const Backend ObstructionBackend = {
+    "obstruction", Obstruction::Init, Obstruction::Bishop, Obstruction::Rook, Obstruction::Queen,
+    Obstruction::XrayBishop, Obstruction::XrayRook, nullptr, nullptr, nullptr
+};
@@ -0,0 +1,273 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+// Memory for the big lookup tables. A magic or PEXT table is most of a
+// megabyte, and random lookups into it on 4KB pages miss the DTLB a lot, so
+// the tables go on 2MB pages where the system will give us some:
+//
+// 1. Explicit huge pages (MAP_HUGETLB), if the administrator reserved any.
+// 2. Transparent huge pages, by asking for a 2MB-aligned region and
+//    advising the kernel (MADV_HUGEPAGE); it may still back it with small
+//    pages if it's short of memory.
+// 3. Otherwise plain 64-byte aligned memory, if the caller wants it.
+//
+// Setting BBATTACK_HUGE_PAGES=0 in the environment skips the first two.
+// Tables that already sit in shared read-only memory, like magic.cpp's, stay
+// there unless BBATTACK_HUGE_PAGES=1 asks for private huge-page copies.
+
+namespace Pages {
+    constexpr size_t HugePage = 2 << 20;
+    constexpr size_t CacheLine = 64;
+    constexpr int MaxRegions = 16;
+
+    struct Region {
+        uintptr_t Start;
+        size_t Size;
+        size_t BBAttackPages::*Field;
+    };
+
+    // What TableAlloc() handed out, and how. Backends may initialise on
+    // several threads at once, so all of it is under the lock.
+    std::mutex Lock;
+    BBAttackPages Report = {};
+    Region Regions[MaxRegions] = {};
+    int RegionCount = 0;
+
+    size_t RoundUp(const size_t size, const size_t to)
+    {
+        return (size + to - 1) & ~(to - 1);
+    }
+
+    const char* Setting()
+    {
+        const char* env = getenv("BBATTACK_HUGE_PAGES");
+
+        return env != nullptr ? env : "";
+    }
+
+    bool Enabled()
+    {
+        return strcmp(Setting(), "0") != 0;
+    }
+
+    void Count(size_t BBAttackPages::*field, const size_t size, void* p)
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+
+        Report.*field += size;
+
+        if (RegionCount < MaxRegions) {
+            Regions[RegionCount++] = { (uintptr_t)p, size, field };
+        }
+    }
+
+    // Forget a region, and say how it was allocated; null if it wasn't
+    // recorded.
+    size_t BBAttackPages::*Uncount(void* p)
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+
+        for (int i = 0; i < RegionCount; i++) {
+            if (Regions[i].Start == (uintptr_t)p) {
+                size_t BBAttackPages::*field = Regions[i].Field;
+
+                Report.*field -= Regions[i].Size;
+                Regions[i] = Regions[--RegionCount];
+                return field;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // How much of the advised regions the kernel really backs with huge
+    // pages, going by AnonHugePages in /proc/self/smaps. Neighbouring
+    // mappings may have been merged into one, so each mapping's count is
+    // capped at how much of it is ours.
+    size_t Backed()
+    {
+        size_t total = 0;
+#ifdef __linux__
+        FILE* f = fopen("/proc/self/smaps", "r");
+        char line[256];
+        size_t ours = 0;
+
+        if (f == nullptr) {
+            return 0;
+        }
+
+        while (fgets(line, sizeof(line), f) != nullptr) {
+            unsigned long start, end, kb;
+
+            if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+                ours = 0;
+
+                for (int i = 0; i < RegionCount; i++) {
+                    if (Regions[i].Field != &BBAttackPages::TransparentRequested) {
+                        continue;
+                    }
+
+                    const uintptr_t lo = std::max((uintptr_t)start, Regions[i].Start);
+                    const uintptr_t hi = std::min((uintptr_t)end, Regions[i].Start + Regions[i].Size);
+
+                    ours += hi > lo ? hi - lo : 0;
+                }
+            } else if (ours != 0 && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+                total += std::min((size_t)kb << 10, ours);
+            }
+        }
+
+        fclose(f);
+#endif
+        return total;
+    }
+
+    void* HugeTLB(const size_t size)
+    {
+#if defined(__linux__) && defined(MAP_HUGETLB)
+        void* p = mmap(nullptr, RoundUp(size, HugePage), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (p != MAP_FAILED) {
+            return p;
+        }
+#endif
+        (void)size;
+        return nullptr;
+    }
+
+    void* Transparent(const size_t size)
+    {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        const size_t length = RoundUp(size, HugePage);
+
+        // Over-allocate by a page so there is a 2MB boundary to start on,
+        // then hand the slop on either side back.
+        uint8_t* p = (uint8_t*)mmap(nullptr, length + HugePage, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+
+        uint8_t* aligned = (uint8_t*)RoundUp((uintptr_t)p, HugePage);
+
+        if (aligned != p) {
+            munmap(p, aligned - p);
+        }
+
+        munmap(aligned + length, p + HugePage - aligned);
+
+        if (madvise(aligned, length, MADV_HUGEPAGE) == 0) {
+            return aligned;
+        }
+
+        munmap(aligned, length);
+#endif
+        (void)size;
+        return nullptr;
+    }
+}
+
+// Zeroed memory for a table of size bytes, on huge pages if possible and
+// otherwise 64-byte aligned, or null if fallback is false.
+void* TableAlloc(const size_t size, const bool fallback)
+{
+    static const bool enabled = Pages::Enabled();
+    void* p = nullptr;
+
+    if (enabled && (p = Pages::HugeTLB(size)) != nullptr) {
+        Pages::Count(&BBAttackPages::HugeTLB, size, p);
+        return p;
+    }
+
+    if (enabled && (p = Pages::Transparent(size)) != nullptr) {
+        Pages::Count(&BBAttackPages::TransparentRequested, size, p);
+        return p;
+    }
+
+    if (!fallback) {
+        return nullptr;
+    }
+
+    p = aligned_alloc(Pages::CacheLine, Pages::RoundUp(size, Pages::CacheLine));
+
+    if (p == nullptr) {
+        abort();
+    }
+
+    memset(p, 0, size);
+    Pages::Count(&BBAttackPages::Small, size, p);
+    return p;
+}
+
+// Give back a table from TableAlloc(), the same way it was got.
+void TableFree(void* p, const size_t size)
+{
+    size_t BBAttackPages::*field = p != nullptr ? Pages::Uncount(p) : nullptr;
+
+    if (field == &BBAttackPages::Small) {
+        free(p);
+        return;
+    }
+
+#ifdef __linux__
+    if (field != nullptr) {
+        munmap(p, Pages::RoundUp(size, Pages::HugePage));
+    }
+#endif
+    (void)size;
+}
+
+bool TableCopyWanted()
+{
+    return strcmp(Pages::Setting(), "1") == 0;
+}
+
+extern "C" {
+void BBAttackPageReport(struct BBAttackPages* pages)
+{
+    std::lock_guard<std::mutex> lock(Pages::Lock);
+
+    *pages = Pages::Report;
+    pages->Transparent = Pages::Backed();
+}
+}
@@ -0,0 +1,395 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "bbattack-private.h"
+
+#ifdef BBATTACK_X86_TARGETS
+
+#include <immintrin.h>
+
+// Compile just the functions that need it for BMI2, so the rest of the
+// library still runs on older CPUs.
+#define BMI2 __attribute__((target("bmi2")))
+
+namespace Pext {
+
+// The same relevant-occupancy masks and subset enumeration as the magic
+// bitboards, but PEXT squeezes the occupancy straight down to a dense
+// index, so every square gets exactly 2^bits entries and no magic multiply.
+// That is 5248 bishop plus 102400 rook entries.
+static constexpr int TableSize = 107648;
+
+static std::atomic<uint64_t*> PextTable; // 841KB
+
+// The PDEP flavour stores each attack set squeezed down against the
+// square's empty-board attacks instead. A rook attacks at most 14 squares,
+// so 16 bits is enough and the whole thing is a quarter of the size.
+static std::atomic<uint16_t*> PdepTable; // 210KB
+
+// Both tables together, back to back.
+static constexpr size_t TableBytes = TableSize * (sizeof(uint64_t) + sizeof(uint16_t));
+
+// Init and Adopt() set the table pointers while other threads may be
+// looking things up, so they are stored with release and read with acquire
+// (plain loads on x86).
+static uint64_t* Pexts()
+{
+    return PextTable.load(std::memory_order_acquire);
+}
+
+static uint16_t* Pdeps()
+{
+    return PdepTable.load(std::memory_order_acquire);
+}
+
+static uint64_t BishopMask[64];
+static uint64_t RookMask[64];
+
+static uint64_t BishopLine[64];
+static uint64_t RookLine[64];
+
+static unsigned int BishopOffset[64];
+static unsigned int RookOffset[64];
+
+BMI2 uint64_t Bishop(const uint64_t occ, const unsigned int sq)
+{
+    return Pexts()[BishopOffset[sq] + _pext_u64(occ, BishopMask[sq])];
+}
+
+BMI2 uint64_t Rook(const uint64_t occ, const unsigned int sq)
+{
+    return Pexts()[RookOffset[sq] + _pext_u64(occ, RookMask[sq])];
+}
+
+BMI2 uint64_t BishopPdep(const uint64_t occ, const unsigned int sq)
+{
+    return _pdep_u64(Pdeps()[BishopOffset[sq] + _pext_u64(occ, BishopMask[sq])], BishopLine[sq]);
+}
+
+BMI2 uint64_t RookPdep(const uint64_t occ, const unsigned int sq)
+{
+    return _pdep_u64(Pdeps()[RookOffset[sq] + _pext_u64(occ, RookMask[sq])], RookLine[sq]);
+}
+
+BMI2 uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    const unsigned int bishop = BishopOffset[sq] + _pext_u64(occ, BishopMask[sq]);
+    const unsigned int rook = RookOffset[sq] + _pext_u64(occ, RookMask[sq]);
+
+    const uint64_t* const table = Pexts();
+
+    return table[bishop] | table[rook];
+}
+
+BMI2 uint64_t QueenPdep(const uint64_t occ, const unsigned int sq)
+{
+    const unsigned int bishop = BishopOffset[sq] + _pext_u64(occ, BishopMask[sq]);
+    const unsigned int rook = RookOffset[sq] + _pext_u64(occ, RookMask[sq]);
+
+    const uint16_t* const table = Pdeps();
+
+    return _pdep_u64(table[bishop], BishopLine[sq]) | _pdep_u64(table[rook], RookLine[sq]);
+}
+
+BMI2 uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Bishop>(occ, blockers, sq);
+}
+
+BMI2 uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<Rook>(occ, blockers, sq);
+}
+
+BMI2 uint64_t XrayBishopPdep(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<BishopPdep>(occ, blockers, sq);
+}
+
+BMI2 uint64_t XrayRookPdep(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return Xray<RookPdep>(occ, blockers, sq);
+}
+
+bool Supported()
+{
+    return __builtin_cpu_supports("bmi2");
+}
+
+// The per-square masks and offsets. Cheap, and wanted on their own by a
+// table file that has the table itself.
+static void BuildMasks()
+{
+    unsigned int offset = 0;
+    int sq;
+
+    for (sq = 0; sq < 64; sq++) {
+        BishopMask[sq] = CalcBishopMask(sq);
+        BishopLine[sq] = CalcBishopAttacks(sq, 0);
+        BishopOffset[sq] = offset;
+        offset += 1U << __builtin_popcountll(BishopMask[sq]);
+    }
+
+    for (sq = 0; sq < 64; sq++) {
+        RookMask[sq] = CalcRookMask(sq);
+        RookLine[sq] = CalcRookAttacks(sq, 0);
+        RookOffset[sq] = offset;
+        offset += 1U << __builtin_popcountll(RookMask[sq]);
+    }
+
+    assert(offset == TableSize);
+}
+
+// The masks are set up exactly once, however many threads ask. The table
+// memory and each square's sub-table are built under Lock, a square at a
+// time so the lazy lookups below can build just the squares they are asked
+// about; a square's Built flag lets lookups that find it done skip the
+// lock. Unlike once_flags, the flags can be cleared again by Release().
+static std::once_flag MasksOnce;
+static std::mutex Lock;
+static std::atomic<bool> BishopBuilt[64];
+static std::atomic<bool> RookBuilt[64];
+
+// The table InitTable() allocated, if it did; Adopt() and Release() give
+// it back.
+static uint64_t* Allocated;
+
+static void InitMasks()
+{
+    std::call_once(MasksOnce, BuildMasks);
+}
+
+static void Publish(uint64_t* table)
+{
+    PextTable.store(table, std::memory_order_release);
+    PdepTable.store(table != nullptr ? (uint16_t*)(table + TableSize) : nullptr, std::memory_order_release);
+}
+
+// Both tables together fit in one 2MB page. Skipped if a table file has
+// been mapped in the meantime. Call with Lock held.
+static void InitTable()
+{
+    if (Pexts() == nullptr) {
+        Allocated = (uint64_t*)TableAlloc(TableBytes, true);
+        Publish(Allocated);
+    }
+}
+
+BMI2 static void BuildBishop(const unsigned int sq)
+{
+    uint64_t b = 0, attacks;
+
+    do {
+        attacks = CalcBishopAttacks(sq, b);
+        Pexts()[BishopOffset[sq] + _pext_u64(b, BishopMask[sq])] = attacks;
+        Pdeps()[BishopOffset[sq] + _pext_u64(b, BishopMask[sq])] = _pext_u64(attacks, BishopLine[sq]);
+    } while ((b = SNOOB(BishopMask[sq], b)));
+}
+
+BMI2 static void BuildRook(const unsigned int sq)
+{
+    uint64_t b = 0, attacks;
+
+    do {
+        attacks = CalcRookAttacks(sq, b);
+        Pexts()[RookOffset[sq] + _pext_u64(b, RookMask[sq])] = attacks;
+        Pdeps()[RookOffset[sq] + _pext_u64(b, RookMask[sq])] = _pext_u64(attacks, RookLine[sq]);
+    } while ((b = SNOOB(RookMask[sq], b)));
+}
+
+template<std::atomic<bool>* built, void (*build)(const unsigned int sq)>
+static void Ensure(const unsigned int sq)
+{
+    if (built[sq].load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(Lock);
+
+    if (!built[sq].load(std::memory_order_relaxed)) {
+        InitTable();
+        build(sq);
+        built[sq].store(true, std::memory_order_release);
+    }
+}
+
+void Init()
+{
+    unsigned int sq;
+
+    InitMasks();
+
+    for (sq = 0; sq < 64; sq++) {
+        Ensure<BishopBuilt, BuildBishop>(sq);
+        Ensure<RookBuilt, BuildRook>(sq);
+    }
+}
+
+// Lazy lookups go through a function pointer per square. Each starts out
+// at a stub that builds the square's sub-table, points the square at the
+// real lookup and hands over to it, so after the first touch there is no
+// test of whether the square is ready, just the indirect call.
+using Lookup = uint64_t (*)(const uint64_t occ, const unsigned int sq);
+
+static std::atomic<Lookup> BishopLazyLookup[64];
+static std::atomic<Lookup> RookLazyLookup[64];
+static std::atomic<Lookup> BishopPdepLazyLookup[64];
+static std::atomic<Lookup> RookPdepLazyLookup[64];
+
+template<Lookup lookup, std::atomic<Lookup>* table, std::atomic<bool>* built, void (*build)(const unsigned int sq)>
+uint64_t Stub(const uint64_t occ, const unsigned int sq)
+{
+    Ensure<built, build>(sq);
+    table[sq].store(lookup, std::memory_order_release);
+
+    return lookup(occ, sq);
+}
+
+static void ResetLazy()
+{
+    unsigned int sq;
+
+    for (sq = 0; sq < 64; sq++) {
+        BishopLazyLookup[sq].store(Stub<Bishop, BishopLazyLookup, BishopBuilt, BuildBishop>, std::memory_order_release);
+        RookLazyLookup[sq].store(Stub<Rook, RookLazyLookup, RookBuilt, BuildRook>, std::memory_order_release);
+        BishopPdepLazyLookup[sq].store(Stub<BishopPdep, BishopPdepLazyLookup, BishopBuilt, BuildBishop>, std::memory_order_release);
+        RookPdepLazyLookup[sq].store(Stub<RookPdep, RookPdepLazyLookup, RookBuilt, BuildRook>, std::memory_order_release);
+    }
+}
+
+void InitLazy()
+{
+    InitMasks();
+    ResetLazy();
+}
+
+template<std::atomic<Lookup>* table>
+uint64_t Lazy(const uint64_t occ, const unsigned int sq)
+{
+    return table[sq].load(std::memory_order_acquire)(occ, sq);
+}
+
+template<std::atomic<Lookup>* bishop, std::atomic<Lookup>* rook>
+uint64_t LazyQueen(const uint64_t occ, const unsigned int sq)
+{
+    return Lazy<bishop>(occ, sq) | Lazy<rook>(occ, sq);
+}
+
+// Calibration timed pext and picked something else: give the table back
+// and start again from nothing, lazy stubs included, should pext be
+// selected later. A mapped table file isn't ours to give back. Nobody may
+// be looking anything up with pext meanwhile.
+void Release()
+{
+    unsigned int sq;
+    std::lock_guard<std::mutex> lock(Lock);
+
+    if (Allocated == nullptr || Pexts() != Allocated) {
+        return;
+    }
+
+    for (sq = 0; sq < 64; sq++) {
+        BishopBuilt[sq].store(false, std::memory_order_relaxed);
+        RookBuilt[sq].store(false, std::memory_order_relaxed);
+    }
+
+    Publish(nullptr);
+    ResetLazy();
+    TableFree(Allocated, TableBytes);
+    Allocated = nullptr;
+}
+
+// For table files: both tables, back to back.
+void Image(TableImage* image)
+{
+    InitMasks();
+
+    image->Hash = TableHash(BishopMask, TableHash(RookMask));
+    image->Data = Pexts();
+    image->Size = TableBytes;
+    image->BishopOffset = BishopOffset;
+    image->RookOffset = RookOffset;
+}
+
+// Under the lock, point the lookups at the mapped table and only then mark
+// every square built, so that nobody who finds a square built can see the
+// old or a null pointer, and no build is left running to write into the
+// mapped table, which is complete and read-only. The table Init() built is
+// no use to anyone after that, and goes back.
+void Adopt(const void* data)
+{
+    unsigned int sq;
+    std::lock_guard<std::mutex> lock(Lock);
+
+    InitMasks();
+    Publish((uint64_t*)data);
+
+    for (sq = 0; sq < 64; sq++) {
+        BishopBuilt[sq].store(true, std::memory_order_release);
+        RookBuilt[sq].store(true, std::memory_order_release);
+    }
+
+    TableFree(Allocated, TableBytes);
+    Allocated = nullptr;
+}
+}
+
+const Backend PextLazyBackend = {
+    "pext", Pext::InitLazy,
+    Pext::Lazy<Pext::BishopLazyLookup>, Pext::Lazy<Pext::RookLazyLookup>,
+    Pext::LazyQueen<Pext::BishopLazyLookup, Pext::RookLazyLookup>,
+    Xray<Pext::Lazy<Pext::BishopLazyLookup>>, Xray<Pext::Lazy<Pext::RookLazyLookup>>,
+    Pext::Supported, nullptr, Pext::Release
+};
+
+const Backend PextPdepLazyBackend = {
+    "pext-pdep", Pext::InitLazy,
+    Pext::Lazy<Pext::BishopPdepLazyLookup>, Pext::Lazy<Pext::RookPdepLazyLookup>,
+    Pext::LazyQueen<Pext::BishopPdepLazyLookup, Pext::RookPdepLazyLookup>,
+    Xray<Pext::Lazy<Pext::BishopPdepLazyLookup>>, Xray<Pext::Lazy<Pext::RookPdepLazyLookup>>,
+    Pext::Supported, nullptr, Pext::Release
+};
+
+const Backend PextBackend = {
+    "pext", Pext::Init, Pext::Bishop, Pext::Rook, Pext::Queen,
+    Pext::XrayBishop, Pext::XrayRook, Pext::Supported, &PextLazyBackend, Pext::Release
+};
+
+const Backend PextPdepBackend = {
+    "pext-pdep", Pext::Init, Pext::BishopPdep, Pext::RookPdep, Pext::QueenPdep,
+    Pext::XrayBishopPdep, Pext::XrayRookPdep, Pext::Supported, &PextPdepLazyBackend, Pext::Release
+};
+
+const TableSource PextTableSource = {
+    "pext", 3, Pext::Image, Pext::Adopt
+};
+
+#endif // #ifdef BBATTACK_X86_TARGETS
@@ -27,14 +27,14 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "bbattack.h"
-
-#ifdef USE_SBAMG
-
 #include "bbattack-private.h"
 
-static struct {
-    uint64_t Lower;
+namespace SBAMG {
+
+// The bits below the square are the same for all four lines, and cheap to
+// work out, so they aren't stored; what is left of a square's masks, rook
+// and bishop lines alike, fills exactly one 64-byte cache line.
+alignas(64) static struct {
     uint64_t Line;
     uint64_t Outer;
 } SBAMGMasks[64][4];
@@ -47,11 +47,13 @@ namespace {
         Rank
     };
 
-    template<MaskType type> uint64_t MaskLower(const unsigned int sq)
+    // Bit 0 is always in Outer, so it can be in here on every square,
+    // which keeps a1 from having an empty mask.
+    uint64_t MaskLower(const unsigned int sq)
     {
         assert(sq <= 63);
 
-        return SBAMGMasks[sq][type].Lower;
+        return ((1ULL << sq) - 1) | 1;
     }
 
     template<MaskType type> uint64_t MaskLine(const unsigned int sq)
@@ -82,49 +84,75 @@ namespace {
     {
         const uint64_t line = (occ & MaskLine<type>(sq)) | MaskOuter<type>(sq);
 
-        const uint64_t blocker = 3ULL << MSB(line & MaskLower<type>(sq));
+        const uint64_t blocker = 3ULL << MSB(line & MaskLower(sq));
 
         return (line ^ (line - blocker)) & MaskLine<type>(sq);
     }
+
+    // Lift the blockers it found off the line and go again; both passes
+    // use the same masks.
+    template<MaskType type> uint64_t SBAMGXray(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+    {
+        const uint64_t attacks = SBAMG<type>(occ, sq);
+
+        return attacks ^ SBAMG<type>(occ & ~(attacks & blockers), sq);
+    }
 }
 
-extern "C" {
-uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq)
+uint64_t Bishop(const uint64_t occ, const unsigned int sq)
 {
     return SBAMG<MaskType::Diagonal>(occ, sq) | 
         SBAMG<MaskType::Antidiagonal>(occ, sq);
 }
 
-uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq)
+uint64_t Rook(const uint64_t occ, const unsigned int sq)
 {
     return SBAMG<MaskType::Rank>(occ, sq) |
         SBAMG<MaskType::File>(occ, sq);
 }
 
-void BBAttackInit()
+uint64_t Queen(const uint64_t occ, const unsigned int sq)
+{
+    return SBAMG<MaskType::Diagonal>(occ, sq) |
+        SBAMG<MaskType::Antidiagonal>(occ, sq) |
+        SBAMG<MaskType::Rank>(occ, sq) |
+        SBAMG<MaskType::File>(occ, sq);
+}
+
+uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return SBAMGXray<MaskType::Diagonal>(occ, blockers, sq) |
+        SBAMGXray<MaskType::Antidiagonal>(occ, blockers, sq);
+}
+
+uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq)
+{
+    return SBAMGXray<MaskType::Rank>(occ, blockers, sq) |
+        SBAMGXray<MaskType::File>(occ, blockers, sq);
+}
+
+void Init()
 {
-    int sq, dest;
-    uint64_t mask;
+    int sq;
 
     for (sq = 0; sq < 64; sq++) {
 
-        SBAMGMasks[sq][MaskType::Rank].Lower = (sq == 0) ? 1ULL : ((1ULL << sq) - 1);
         SBAMGMasks[sq][MaskType::Rank].Line  = GenMask<East, false>(sq) | GenMask<West, false>(sq);
         SBAMGMasks[sq][MaskType::Rank].Outer = GenOuter<East>(sq) | GenOuter<West>(sq) | 1;
 
-        SBAMGMasks[sq][MaskType::File].Lower = (sq == 0) ? 1ULL : ((1ULL << sq) - 1);
         SBAMGMasks[sq][MaskType::File].Line  = GenMask<North, false>(sq) | GenMask<South, false>(sq);
         SBAMGMasks[sq][MaskType::File].Outer = GenOuter<North>(sq) | GenOuter<South>(sq) | 1;
 
-        SBAMGMasks[sq][MaskType::Diagonal].Lower = (sq == 0) ? 1ULL : ((1ULL << sq) - 1);
         SBAMGMasks[sq][MaskType::Diagonal].Line  = GenMask<Northeast, false>(sq) | GenMask<Southwest, false>(sq);
         SBAMGMasks[sq][MaskType::Diagonal].Outer = GenOuter<Northeast>(sq) | GenOuter<Southwest>(sq) | 1;
 
-        SBAMGMasks[sq][MaskType::Antidiagonal].Lower = (sq == 0) ? 1ULL : ((1ULL << sq) - 1);
         SBAMGMasks[sq][MaskType::Antidiagonal].Line  = GenMask<Northwest, false>(sq) | GenMask<Southeast, false>(sq);
         SBAMGMasks[sq][MaskType::Antidiagonal].Outer = GenOuter<Northwest>(sq) | GenOuter<Southeast>(sq) | 1;
     }
 }
 }
 
-#endif // #ifdef USE_SBAMG
+const Backend SBAMGBackend = {
+    "sbamg", SBAMG::Init, SBAMG::Bishop, SBAMG::Rook, SBAMG::Queen,
+    SBAMG::XrayBishop, SBAMG::XrayRook, nullptr, nullptr, nullptr
+};
@@ -0,0 +1,90 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+// Attacks of a whole set of sliders at once. Kogge-Stone fills every
+// generator in the set in parallel, so this costs the same for one rook as
+// for ten, and doesn't depend on which backend is bound.
+
+namespace SetWise {
+    using KoggeStone::KoggeStone;
+
+    uint64_t Bishop(const uint64_t empty, const uint64_t sliders)
+    {
+        return KoggeStone<Northeast>(empty, sliders) |
+               KoggeStone<Northwest>(empty, sliders) |
+               KoggeStone<Southeast>(empty, sliders) |
+               KoggeStone<Southwest>(empty, sliders);
+    }
+
+    uint64_t Rook(const uint64_t empty, const uint64_t sliders)
+    {
+        return KoggeStone<North>(empty, sliders) |
+               KoggeStone<South>(empty, sliders) |
+               KoggeStone<East >(empty, sliders) |
+               KoggeStone<West >(empty, sliders);
+    }
+}
+
+extern "C" {
+uint64_t BBAttackBishopSet(const uint64_t occupancy, const uint64_t sliders)
+{
+    return SetWise::Bishop(~occupancy, sliders);
+}
+
+uint64_t BBAttackRookSet(const uint64_t occupancy, const uint64_t sliders)
+{
+    return SetWise::Rook(~occupancy, sliders);
+}
+
+uint64_t BBAttackQueenSet(const uint64_t occupancy, const uint64_t sliders)
+{
+    return SetWise::Bishop(~occupancy, sliders) | SetWise::Rook(~occupancy, sliders);
+}
+
+uint64_t BBAttackRaySet(const uint64_t occupancy, const uint64_t sliders, const enum BBDirection direction)
+{
+    using KoggeStone::KoggeStone;
+    const uint64_t empty = ~occupancy;
+
+    switch (direction) {
+    case BBNorth:     return KoggeStone<North    >(empty, sliders);
+    case BBSouth:     return KoggeStone<South    >(empty, sliders);
+    case BBEast:      return KoggeStone<East     >(empty, sliders);
+    case BBWest:      return KoggeStone<West     >(empty, sliders);
+    case BBNortheast: return KoggeStone<Northeast>(empty, sliders);
+    case BBSoutheast: return KoggeStone<Southeast>(empty, sliders);
+    case BBSouthwest: return KoggeStone<Southwest>(empty, sliders);
+    case BBNorthwest: return KoggeStone<Northwest>(empty, sliders);
+    }
+
+    return 0;
+}
+}
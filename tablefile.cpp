@@ -0,0 +1,208 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BBATTACK_BUILDING_LIBRARY
+
+#include "bbattack.h"
+#include "bbattack-private.h"
+
+// Table files. One file holds one backend's table:
+//
+//     header   TableFileHeader, zero-padded to 4KB
+//     payload  the table exactly as the backend looks it up, PayloadSize
+//              bytes, page aligned so it can be mapped as it stands
+//
+// Everything is in the byte order of the machine that wrote it; the
+// signature doubles as a byte order check. Offsets are 32-bit indices into
+// the payload, not pointers, so the file means the same wherever it's
+// mapped. Bump TableFileVersion whenever the layout changes.
+
+namespace TableFile {
+
+constexpr uint32_t TableFileVersion = 1;
+constexpr size_t PayloadAlign = 4096;
+
+struct TableFileHeader {
+    char Signature[8];          // "BBATTACK"
+    uint32_t Version;           // TableFileVersion
+    uint32_t Backend;           // TableSource::Id
+    uint64_t Hash;              // TableImage::Hash
+    uint64_t Checksum;          // FNV-1a of the payload
+    uint64_t PayloadOffset;     // From the start of the file
+    uint64_t PayloadSize;       // Bytes
+    uint32_t BishopOffset[64];
+    uint32_t RookOffset[64];
+};
+
+static_assert(sizeof(TableFileHeader) <= PayloadAlign, "Table file header doesn't fit in front of the payload");
+static_assert(sizeof(unsigned int) == sizeof(uint32_t), "Table offsets are stored as 32 bits");
+
+const char Signature[8] = { 'B', 'B', 'A', 'T', 'T', 'A', 'C', 'K' };
+
+const TableSource* const Sources[] = {
+    &MagicTableSource,
+    &BlackMagicTableSource,
+#ifdef BBATTACK_X86_TARGETS
+    &PextTableSource,
+#endif
+};
+
+const TableSource* FindById(const uint32_t id)
+{
+    for (const TableSource* source : Sources) {
+        if (source->Id == id) {
+            return source;
+        }
+    }
+
+    return nullptr;
+}
+
+const TableSource* FindByName(const char* name)
+{
+    for (const TableSource* source : Sources) {
+        if (strcmp(source->Name, name) == 0) {
+            return source;
+        }
+    }
+
+    return nullptr;
+}
+
+// Whether a header describes the table this build would make itself.
+bool Matches(const TableFileHeader& header, const TableImage& image)
+{
+    return header.Hash == image.Hash &&
+        header.PayloadSize == image.Size &&
+        memcmp(header.BishopOffset, image.BishopOffset, sizeof(header.BishopOffset)) == 0 &&
+        memcmp(header.RookOffset, image.RookOffset, sizeof(header.RookOffset)) == 0;
+}
+}
+
+// Write the named backend's table, which must already be initialised, to
+// path. Returns 0 on success, or -1 on any error.
+int WriteTableFile(const char* name, const char* path)
+{
+    using namespace TableFile;
+
+    const TableSource* source = FindByName(name);
+    TableFileHeader header = {};
+    TableImage image = {};
+    uint8_t pad[PayloadAlign] = {};
+
+    if (source == nullptr) {
+        return -1;
+    }
+
+    source->Image(&image);
+
+    if (image.Data == nullptr) {
+        return -1;
+    }
+
+    memcpy(header.Signature, Signature, sizeof(Signature));
+    header.Version = TableFileVersion;
+    header.Backend = source->Id;
+    header.Hash = image.Hash;
+    header.Checksum = Fnv1a(image.Data, image.Size);
+    header.PayloadOffset = PayloadAlign;
+    header.PayloadSize = image.Size;
+    memcpy(header.BishopOffset, image.BishopOffset, sizeof(header.BishopOffset));
+    memcpy(header.RookOffset, image.RookOffset, sizeof(header.RookOffset));
+
+    FILE* f = fopen(path, "wb");
+
+    if (f == nullptr) {
+        return -1;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(pad, PayloadAlign - sizeof(header), 1, f) == 1 &&
+        fwrite(image.Data, image.Size, 1, f) == 1;
+
+    ok = (fclose(f) == 0) && ok;
+
+    return ok ? 0 : -1;
+}
+
+extern "C" {
+int BBAttackLoadTables(const char* path)
+{
+    using namespace TableFile;
+
+    TableImage image = {};
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < PayloadAlign) {
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const TableFileHeader& header = *(const TableFileHeader*)map;
+    const TableSource* source = nullptr;
+
+    bool ok = memcmp(header.Signature, Signature, sizeof(Signature)) == 0 &&
+        header.Version == TableFileVersion &&
+        (source = FindById(header.Backend)) != nullptr &&
+        header.PayloadOffset % PayloadAlign == 0 &&
+        header.PayloadOffset + header.PayloadSize == (uint64_t)st.st_size;
+
+    if (ok) {
+        source->Image(&image);
+        ok = Matches(header, image);
+    }
+
+    const uint8_t* payload = (const uint8_t*)map + header.PayloadOffset;
+
+    if (!ok || Fnv1a(payload, header.PayloadSize) != header.Checksum) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    source->Adopt(payload);
+
+    return 0;
+}
+}
@@ -0,0 +1,377 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Incremental attack maps against recomputing them from scratch.
+//
+// Build with something like:
+//     g++ -O2 -o attack-map tools/attack-map.cpp *.cpp
+//
+// Usage: attack-map [-b backend] [-g games] [-t trials] [-r rounds]
+//
+// The corpus is synthetic games in the style of bench's "game" distribution,
+// but with real piece kinds starting from the initial position, and sliders
+// moving along their lines. At every position the search stand-in makes and
+// unmakes trials moves, reading a few attacks-to sets each time, then plays
+// one of them for real. "incremental" does that with BBAttackMapMakeMove()
+// and BBAttackMapUnmake(), and "incremental-to" likewise with the map
+// keeping its attacks-to sets (BBATTACK_MAP_ATTACKS_TO); "full" rebuilds the
+// whole map, attacks-to sets and all, for every move, as BBAttackMapInit()
+// does; "attacks" only looks up each slider's attacks, with no attacks-to
+// sets, which is the least a from-scratch search would do. Before timing,
+// every incremental map is checked against a full one.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "../bbattack.h"
+
+namespace {
+    enum Method {
+        Incremental,
+        IncrementalTo,
+        Full,
+        AttacksOnly,
+        MethodCount
+    };
+
+    const char* const MethodName[MethodCount] = {
+        "incremental", "incremental-to", "full", "attacks"
+    };
+
+    struct Position {
+        uint64_t occ;
+        uint64_t bishops;
+        uint64_t rooks;
+    };
+
+    // One trial move, with whether it's the one that gets played.
+    struct Move {
+        uint8_t from;
+        uint8_t to;
+        bool played;
+        bool last;      // last move of a game; start again after it
+    };
+
+    const Position StartPosition = {
+        0xFFFF00000000FFFFULL,
+        0x2C0000000000002CULL,
+        0x8900000000000089ULL
+    };
+
+    uint64_t XorShift(uint64_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    unsigned int RandomBit(uint64_t& state, uint64_t bb)
+    {
+        int n = XorShift(state) % __builtin_popcountll(bb);
+
+        while (n--) {
+            bb &= bb - 1;
+        }
+
+        return __builtin_ctzll(bb);
+    }
+
+    Position Play(Position pos, const unsigned int from, const unsigned int to)
+    {
+        const uint64_t from_bit = 1ULL << from;
+        const uint64_t to_bit = 1ULL << to;
+
+        pos.occ = (pos.occ & ~from_bit) | to_bit;
+        pos.bishops = (pos.bishops & ~to_bit) | ((pos.bishops & from_bit) ? to_bit : 0);
+        pos.rooks = (pos.rooks & ~to_bit) | ((pos.rooks & from_bit) ? to_bit : 0);
+        pos.bishops &= ~from_bit;
+        pos.rooks &= ~from_bit;
+
+        return pos;
+    }
+
+    // Where a piece on sq may go: along its attacks for a slider, and
+    // anywhere within two squares for anything else, which is near enough
+    // for pawns, knights and kings. Colours aren't tracked, so anything in
+    // the way can be captured.
+    uint64_t Targets(const Position& pos, const unsigned int sq)
+    {
+        const uint64_t bit = 1ULL << sq;
+        uint64_t near = 0;
+
+        if (pos.bishops & pos.rooks & bit) {
+            return BBAttackQueen(pos.occ, sq);
+        } else if (pos.bishops & bit) {
+            return BBAttackBishop(pos.occ, sq);
+        } else if (pos.rooks & bit) {
+            return BBAttackRook(pos.occ, sq);
+        }
+
+        for (int dest = 0; dest < 64; dest++) {
+            const int files = abs(dest % 8 - (int)sq % 8);
+            const int ranks = abs(dest / 8 - (int)sq / 8);
+
+            if (dest != (int)sq && files <= 2 && ranks <= 2) {
+                near |= 1ULL << dest;
+            }
+        }
+
+        return near;
+    }
+
+    // Pieces move about and capture, until only a handful are left or the
+    // game has gone on long enough.
+    std::vector<Move> GenCorpus(const int games, const int trials)
+    {
+        std::vector<Move> moves;
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+
+        for (int game = 0; game < games; game++) {
+            Position pos = StartPosition;
+
+            for (int ply = 0; ply < 200 && __builtin_popcountll(pos.occ) > 4; ply++) {
+                Move move = { 0, 0, false, false };
+
+                for (int i = 0; i < trials; i++) {
+                    uint64_t targets = 0;
+
+                    do {
+                        move.from = RandomBit(state, pos.occ);
+                        targets = Targets(pos, move.from);
+
+                        // Mostly quiet moves, as in a real game.
+                        if ((XorShift(state) & 7) != 0 && (targets & ~pos.occ) != 0) {
+                            targets &= ~pos.occ;
+                        }
+                    } while (targets == 0);
+
+                    move.to = RandomBit(state, targets);
+
+                    move.played = i == trials - 1;
+                    moves.push_back(move);
+                }
+
+                pos = Play(pos, move.from, move.to);
+            }
+
+            moves.back().last = true;
+        }
+
+        return moves;
+    }
+
+    // Something to do with the attacks, so they can't be skipped.
+    uint64_t Use(const BBAttackMap& map, const Move& move)
+    {
+        return BBAttackMapAttacksTo(&map, move.to) ^
+            BBAttackMapAttacksTo(&map, move.from) ^ map.Attacks[move.to];
+    }
+
+    bool Same(const BBAttackMap& a, const BBAttackMap& b)
+    {
+        for (unsigned int sq = 0; sq < 64; sq++) {
+            if (BBAttackMapAttacksTo(&a, sq) != BBAttackMapAttacksTo(&b, sq)) {
+                return false;
+            }
+        }
+
+        return a.Occupancy == b.Occupancy && a.Bishops == b.Bishops &&
+            a.Rooks == b.Rooks &&
+            memcmp(a.Attacks, b.Attacks, sizeof(a.Attacks)) == 0;
+    }
+
+    bool Check(const std::vector<Move>& moves, const unsigned int flags)
+    {
+        std::unique_ptr<BBAttackMap> map(new BBAttackMap), full(new BBAttackMap);
+        Position pos = StartPosition;
+
+        BBAttackMapInit(map.get(), pos.occ, pos.bishops, pos.rooks, flags);
+
+        for (const Move& move : moves) {
+            const Position next = Play(pos, move.from, move.to);
+
+            BBAttackMapMakeMove(map.get(), move.from, move.to);
+            BBAttackMapInit(full.get(), next.occ, next.bishops, next.rooks,
+                BBATTACK_MAP_ATTACKS_TO);
+
+            if (!Same(*map, *full)) {
+                return false;
+            }
+
+            if (move.played) {
+                pos = move.last ? StartPosition : next;
+
+                if (move.last) {
+                    BBAttackMapInit(map.get(), pos.occ, pos.bishops, pos.rooks, flags);
+                }
+            } else {
+                BBAttackMapUnmake(map.get());
+                BBAttackMapInit(full.get(), pos.occ, pos.bishops, pos.rooks,
+                    BBATTACK_MAP_ATTACKS_TO);
+
+                if (!Same(*map, *full)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    uint64_t Run(const Method method, const std::vector<Move>& moves, BBAttackMap& map)
+    {
+        const unsigned int flags = method == Incremental ? 0 : BBATTACK_MAP_ATTACKS_TO;
+        Position pos = StartPosition;
+        uint64_t acc = 0;
+
+        BBAttackMapInit(&map, pos.occ, pos.bishops, pos.rooks, flags);
+
+        for (const Move& move : moves) {
+            const Position next = Play(pos, move.from, move.to);
+
+            switch (method) {
+            case Incremental:
+            case IncrementalTo:
+                BBAttackMapMakeMove(&map, move.from, move.to);
+                acc ^= Use(map, move);
+
+                if (!move.played) {
+                    BBAttackMapUnmake(&map);
+                }
+                break;
+            case Full:
+                BBAttackMapInit(&map, next.occ, next.bishops, next.rooks, flags);
+                acc ^= Use(map, move);
+                break;
+            default:
+                for (uint64_t sliders = next.bishops | next.rooks; sliders;
+                    sliders &= sliders - 1) {
+                    const unsigned int sq = __builtin_ctzll(sliders);
+                    const uint64_t bit = 1ULL << sq;
+
+                    if (next.bishops & next.rooks & bit) {
+                        map.Attacks[sq] = BBAttackQueen(next.occ, sq);
+                    } else if (next.bishops & bit) {
+                        map.Attacks[sq] = BBAttackBishop(next.occ, sq);
+                    } else {
+                        map.Attacks[sq] = BBAttackRook(next.occ, sq);
+                    }
+                }
+
+                acc ^= map.Attacks[move.to];
+                break;
+            }
+
+            if (move.played) {
+                pos = move.last ? StartPosition : next;
+
+                if (move.last && (method == Incremental || method == IncrementalTo)) {
+                    BBAttackMapInit(&map, pos.occ, pos.bishops, pos.rooks, flags);
+                }
+            }
+        }
+
+        return acc;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* backend = nullptr;
+    int games = 1000;
+    int trials = 8;
+    int rounds = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
+
+        if (strcmp(argv[i], "-b") == 0 && has_arg) {
+            backend = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && has_arg) {
+            games = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "-t") == 0 && has_arg) {
+            trials = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "-r") == 0 && has_arg) {
+            rounds = std::max(atoi(argv[++i]), 1);
+        } else {
+            fprintf(stderr, "usage: %s [-b backend] [-g games] [-t trials] "
+                "[-r rounds]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    BBAttackInit();
+
+    if (backend != nullptr && BBAttackSelect(backend) != 0) {
+        fprintf(stderr, "attack-map: no usable backend called \"%s\"\n", backend);
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<Move> moves = GenCorpus(games, trials);
+
+    printf("backend %s, %zu moves over %d games\n", BBAttackBackend(),
+        moves.size(), games);
+
+    if (!Check(moves, 0) || !Check(moves, BBATTACK_MAP_ATTACKS_TO)) {
+        puts("error: incremental map differs from a full rebuild");
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<BBAttackMap> map(new BBAttackMap);
+    volatile uint64_t sink = 0;
+
+    printf("%-15s %10s\n", "method", "ns/move");
+
+    for (int method = 0; method < MethodCount; method++) {
+        using Clock = std::chrono::steady_clock;
+        double best = 0.0;
+
+        // The best of several rounds, after an untimed one to warm up.
+        for (int round = -1; round < rounds; round++) {
+            const Clock::time_point start = Clock::now();
+
+            sink = sink ^ Run((Method)method, moves, *map);
+
+            const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            const double ns = elapsed.count() / moves.size();
+
+            if (round == 0 || (round > 0 && ns < best)) {
+                best = ns;
+            }
+        }
+
+        printf("%-15s %10.2f\n", MethodName[method], best);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,602 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Microbenchmark for every linked-in attack generation system.
+//
+// Build with something like:
+//     g++ -O2 -o bench tools/bench.cpp *.cpp
+//
+// Usage: bench [-b backend] [-d distribution] [-m mode] [-n queries] [-r rounds] [-v] [-c]
+//
+// Throughput mode feeds independent queries, so an out-of-order core can
+// overlap them. Latency mode makes each query's occupancy depend on the
+// previous result (by toggling the slider's own square, which never changes
+// the answer), so the lookups run back to back.
+//
+// cyc/q is measured with the time stamp counter, so it counts reference
+// cycles rather than core cycles when the clock speed moves around.
+//
+// ns/q and cyc/q time each round as a whole. p50, p90, p99 and the -v
+// histogram come from separate rounds that read the clock around every
+// batch of 256 queries, so they carry the cost of those clock reads.
+//
+// -c adds hardware performance counters per query (Linux only, through
+// perf_event_open): core cycles, instructions, branch misses, L1D and
+// last-level cache read misses, and data TLB read misses. They're read over
+// separate untimed rounds, so the timing calls don't get counted. Counters
+// the kernel or CPU won't give us (in a VM, say, or with a strict
+// perf_event_paranoid) read "-", and the rest of the output is the same.
+// When there are more counters than the PMU has, the kernel takes turns
+// and the counts are scaled up from the time each was running.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_PERF_EVENTS
+#endif
+
+#include "../bbattack.h"
+#include "corpus.h"
+
+namespace {
+    enum Distribution {
+        Uniform,    // every square occupied with probability 1/2
+        Sparse,     // 1/8
+        Dense,      // 7/8
+        Game,       // synthetic games, slider on an occupied square
+        DistributionCount
+    };
+
+    const char* const DistributionName[DistributionCount] = {
+        "uniform", "sparse", "dense", "game"
+    };
+
+    enum Mode {
+        Throughput,
+        Latency,
+        ModeCount
+    };
+
+    const char* const ModeName[ModeCount] = {
+        "throughput", "latency"
+    };
+
+    enum Piece {
+        Bishop,
+        Rook,
+        Queen,
+        PieceCount
+    };
+
+    const char* const PieceName[PieceCount] = {
+        "bishop", "rook", "queen"
+    };
+
+    // Queries per timed batch; the percentiles are taken over batches.
+    constexpr int BatchSize = 256;
+
+    struct Query {
+        uint64_t occ;
+        unsigned int sq;
+    };
+
+    void GenQueries(const Distribution dist, Query* queries, const int n)
+    {
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+
+        if (dist == Game) {
+            Corpus::GenGame(state, queries, n);
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const uint64_t a = Corpus::XorShift(state);
+            const uint64_t b = Corpus::XorShift(state);
+            const uint64_t c = Corpus::XorShift(state);
+
+            queries[i].sq = Corpus::XorShift(state) & 63;
+
+            switch (dist) {
+            case Uniform:
+                queries[i].occ = a;
+                break;
+            case Sparse:
+                queries[i].occ = a & b & c;
+                break;
+            case Dense:
+                queries[i].occ = a | b | c;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    enum Counter {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        DTLBMisses,
+        CounterCount
+    };
+
+    const char* const CounterName[CounterCount] = {
+        "cycles", "instr", "br-miss", "l1d-miss", "llc-miss", "dtlb-miss"
+    };
+
+    // One perf event file descriptor per counter, -1 where the kernel said
+    // no.
+    struct Counters {
+        int fd[CounterCount];
+    };
+
+#ifdef HAVE_PERF_EVENTS
+    uint64_t CacheEvent(const uint64_t cache)
+    {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    int OpenCounter(const uint32_t type, const uint64_t config)
+    {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+    // The counters for -c, or none at all without it, so a plain run stays
+    // clear of perf_event_open.
+    Counters OpenCounters(const bool wanted)
+    {
+        Counters counters;
+
+        for (int i = 0; i < CounterCount; i++) {
+            counters.fd[i] = -1;
+        }
+
+        if (!wanted) {
+            return counters;
+        }
+
+#ifdef HAVE_PERF_EVENTS
+        counters.fd[Cycles] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        counters.fd[Instructions] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        counters.fd[BranchMisses] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        counters.fd[L1DMisses] = OpenCounter(PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_L1D));
+        counters.fd[LLCMisses] = OpenCounter(PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_LL));
+        counters.fd[DTLBMisses] = OpenCounter(PERF_TYPE_HW_CACHE, CacheEvent(PERF_COUNT_HW_CACHE_DTLB));
+#endif
+
+        return counters;
+    }
+
+    void CloseCounters(Counters& counters)
+    {
+#ifdef HAVE_PERF_EVENTS
+        for (int i = 0; i < CounterCount; i++) {
+            if (counters.fd[i] >= 0) {
+                close(counters.fd[i]);
+                counters.fd[i] = -1;
+            }
+        }
+#else
+        (void)counters;
+#endif
+    }
+
+    bool AnyCounters(const Counters& counters)
+    {
+        for (int i = 0; i < CounterCount; i++) {
+            if (counters.fd[i] >= 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void StartCounters(const Counters& counters)
+    {
+#ifdef HAVE_PERF_EVENTS
+        for (int i = 0; i < CounterCount; i++) {
+            if (counters.fd[i] >= 0) {
+                ioctl(counters.fd[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(counters.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Counts scaled for multiplexing, or -1 for a counter we don't have.
+    void StopCounters(const Counters& counters, double* counts)
+    {
+        for (int i = 0; i < CounterCount; i++) {
+            counts[i] = -1.0;
+
+#ifdef HAVE_PERF_EVENTS
+            uint64_t value[3]; // count, time enabled, time running
+
+            if (counters.fd[i] < 0) {
+                continue;
+            }
+
+            ioctl(counters.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+            if (read(counters.fd[i], value, sizeof(value)) == sizeof(value) && value[2] > 0) {
+                counts[i] = (double)value[0] * value[1] / value[2];
+            }
+#endif
+        }
+    }
+
+    typedef uint64_t (*AttackFn)(const uint64_t occupancy, const unsigned int square);
+
+    template<AttackFn attack> uint64_t RunThroughput(const Query* queries, const int n)
+    {
+        uint64_t acc = 0;
+
+        for (int i = 0; i < n; i++) {
+            acc ^= attack(queries[i].occ, queries[i].sq);
+        }
+
+        return acc;
+    }
+
+    template<AttackFn attack> uint64_t RunLatency(const Query* queries, const int n, uint64_t prev)
+    {
+        for (int i = 0; i < n; i++) {
+            const unsigned int sq = queries[i].sq;
+            prev = attack(queries[i].occ ^ ((prev & 1) << sq), sq);
+        }
+
+        return prev;
+    }
+
+    struct Result {
+        double ns;
+        double cycles;
+        std::vector<double> batches; // ns/query of each batch
+        double counts[CounterCount]; // per query, or -1
+    };
+
+    uint64_t ReadTSC()
+    {
+#ifdef HAVE_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // The same rounds again, untimed, with the counters running.
+    template<AttackFn attack> void Count(const Mode mode, const Query* queries, const int n, const int rounds,
+        const Counters& counters, double* counts)
+    {
+        volatile uint64_t sink = 0;
+        uint64_t acc = 0;
+
+        StartCounters(counters);
+
+        for (int round = 0; round < rounds; round++) {
+            if (mode == Throughput) {
+                acc ^= RunThroughput<attack>(queries, n);
+            } else {
+                acc = RunLatency<attack>(queries, n, acc);
+            }
+        }
+
+        StopCounters(counters, counts);
+
+        sink = sink ^ acc;
+
+        for (int i = 0; i < CounterCount; i++) {
+            if (counts[i] >= 0.0) {
+                counts[i] /= (double)n * rounds;
+            }
+        }
+    }
+
+    // The same rounds again, reading the clock around each batch for the
+    // percentiles. Kept apart from the timed rounds so the clock reads don't
+    // count towards ns/q.
+    template<AttackFn attack> void Batches(const Mode mode, const Query* queries, const int n, const int rounds,
+        std::vector<double>& batches)
+    {
+        using Clock = std::chrono::steady_clock;
+        volatile uint64_t sink = 0;
+        uint64_t acc = 0;
+
+        for (int round = 0; round < rounds; round++) {
+            for (int i = 0; i < n; i += BatchSize) {
+                const int len = std::min(BatchSize, n - i);
+                const Clock::time_point start = Clock::now();
+
+                if (mode == Throughput) {
+                    acc ^= RunThroughput<attack>(queries + i, len);
+                } else {
+                    acc = RunLatency<attack>(queries + i, len, acc);
+                }
+
+                const Clock::time_point end = Clock::now();
+                batches.push_back(std::chrono::duration<double, std::nano>(end - start).count() / len);
+            }
+        }
+
+        sink = sink ^ acc;
+        std::sort(batches.begin(), batches.end());
+    }
+
+    template<AttackFn attack> Result Run(const Mode mode, const Query* queries, const int n, const int rounds,
+        const Counters* counters)
+    {
+        using Clock = std::chrono::steady_clock;
+        volatile uint64_t sink = 0;
+        Result result = { 0.0, 0.0, {}, { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 } };
+        int64_t total_ns = 0;
+        uint64_t total_tsc = 0;
+
+        // One untimed round to warm up caches and branch predictors.
+        for (int round = -1; round < rounds; round++) {
+            uint64_t acc = 0;
+            const uint64_t tsc_start = ReadTSC();
+            const Clock::time_point start = Clock::now();
+
+            if (mode == Throughput) {
+                acc = RunThroughput<attack>(queries, n);
+            } else {
+                acc = RunLatency<attack>(queries, n, acc);
+            }
+
+            const Clock::time_point end = Clock::now();
+            const uint64_t tsc_end = ReadTSC();
+
+            sink = sink ^ acc;
+
+            if (round >= 0) {
+                total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                total_tsc += tsc_end - tsc_start;
+            }
+        }
+
+        result.ns = (double)total_ns / ((double)n * rounds);
+        result.cycles = (double)total_tsc / ((double)n * rounds);
+
+        Batches<attack>(mode, queries, n, rounds, result.batches);
+
+        if (counters != nullptr) {
+            Count<attack>(mode, queries, n, rounds, *counters, result.counts);
+        }
+
+        return result;
+    }
+
+    Result Run(const Piece piece, const Mode mode, const Query* queries, const int n, const int rounds,
+        const Counters* counters)
+    {
+        switch (piece) {
+        case Bishop:
+            return Run<BBAttackBishop>(mode, queries, n, rounds, counters);
+        case Rook:
+            return Run<BBAttackRook>(mode, queries, n, rounds, counters);
+        default:
+            return Run<BBAttackQueen>(mode, queries, n, rounds, counters);
+        }
+    }
+
+    double Percentile(const std::vector<double>& sorted, const double p)
+    {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+
+        size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    // Ten equal-width buckets between the fastest and the 99th percentile
+    // batch, with everything slower lumped into the last one.
+    void PrintHistogram(const std::vector<double>& sorted)
+    {
+        constexpr int Buckets = 10;
+        constexpr int Width = 50;
+        const double lo = sorted.front();
+        const double hi = std::max(Percentile(sorted, 0.99), lo + 0.01);
+        size_t count[Buckets] = {};
+        size_t most = 0;
+
+        for (double x : sorted) {
+            int bucket = (int)((x - lo) / (hi - lo) * Buckets);
+            bucket = std::min(bucket, Buckets - 1);
+            count[bucket]++;
+            most = std::max(most, count[bucket]);
+        }
+
+        for (int i = 0; i < Buckets; i++) {
+            const double from = lo + (hi - lo) * i / Buckets;
+            const int bar = (int)(count[i] * Width / most);
+
+            printf("    %8.2f ns %s%-*s %zu\n", from, i == Buckets - 1 ? ">" : " ", bar, std::string(bar, '#').c_str(), count[i]);
+        }
+    }
+
+    int Lookup(const char* const* names, const int count, const char* name)
+    {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(names[i], name) == 0) {
+                return i;
+            }
+        }
+
+        fprintf(stderr, "bench: unknown option value \"%s\"\n", name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* only_backend = nullptr;
+    int only_dist = -1;
+    int only_mode = -1;
+    int n = 1 << 16;
+    int rounds = 5;
+    bool verbose = false;
+    bool count = false;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
+
+        if (strcmp(argv[i], "-b") == 0 && has_arg) {
+            only_backend = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && has_arg) {
+            only_dist = Lookup(DistributionName, DistributionCount, argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && has_arg) {
+            only_mode = Lookup(ModeName, ModeCount, argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && has_arg) {
+            n = std::max(atoi(argv[++i]), BatchSize);
+        } else if (strcmp(argv[i], "-r") == 0 && has_arg) {
+            rounds = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            count = true;
+        } else {
+            fprintf(stderr, "usage: %s [-b backend] [-d uniform|sparse|dense|game] [-m throughput|latency] [-n queries] [-r rounds] [-v] [-c]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Query> queries(n);
+
+#ifndef HAVE_TSC
+    puts("note: no cycle counter on this platform, cyc/q will read 0");
+#endif
+
+    Counters counters = OpenCounters(count);
+
+    if (count && !AnyCounters(counters)) {
+        puts("note: no performance counters available here, carrying on without them");
+        count = false;
+    }
+
+    printf("%-16s %-7s %-8s %-10s %8s %8s %8s %8s %8s",
+        "backend", "piece", "dist", "mode", "ns/q", "cyc/q", "p50", "p90", "p99");
+
+    if (count) {
+        for (int i = 0; i < CounterCount; i++) {
+            printf(" %9s", CounterName[i]);
+        }
+    }
+
+    putchar('\n');
+
+    for (unsigned int b = 0; BBAttackBackendName(b) != nullptr; b++) {
+        const char* name = BBAttackBackendName(b);
+
+        if (only_backend != nullptr && strcmp(only_backend, name) != 0) {
+            continue;
+        }
+
+        if (BBAttackSelect(name) != 0) {
+            printf("%-16s skipped, not supported on this CPU\n", name);
+            continue;
+        }
+
+        for (int dist = 0; dist < DistributionCount; dist++) {
+            if (only_dist >= 0 && dist != only_dist) {
+                continue;
+            }
+
+            GenQueries((Distribution)dist, queries.data(), n);
+
+            for (int mode = 0; mode < ModeCount; mode++) {
+                if (only_mode >= 0 && mode != only_mode) {
+                    continue;
+                }
+
+                for (int piece = 0; piece < PieceCount; piece++) {
+                    const Result result = Run((Piece)piece, (Mode)mode, queries.data(), n, rounds, count ? &counters : nullptr);
+
+                    printf("%-16s %-7s %-8s %-10s %8.2f %8.2f %8.2f %8.2f %8.2f",
+                        name, PieceName[piece], DistributionName[dist], ModeName[mode],
+                        result.ns, result.cycles,
+                        Percentile(result.batches, 0.50),
+                        Percentile(result.batches, 0.90),
+                        Percentile(result.batches, 0.99));
+
+                    for (int i = 0; count && i < CounterCount; i++) {
+                        if (result.counts[i] >= 0.0) {
+                            printf(" %9.3f", result.counts[i]);
+                        } else {
+                            printf(" %9s", "-");
+                        }
+                    }
+
+                    putchar('\n');
+
+                    if (verbose) {
+                        PrintHistogram(result.batches);
+                    }
+                }
+            }
+        }
+    }
+
+    BBAttackPages pages;
+    BBAttackPageReport(&pages);
+
+    printf("tables: %zuKB on explicit huge pages, %zuKB on transparent huge pages (of %zuKB advised), %zuKB on small pages\n",
+        pages.HugeTLB >> 10, pages.Transparent >> 10, pages.TransparentRequested >> 10, pages.Small >> 10);
+
+    CloseCounters(counters);
+
+    return EXIT_SUCCESS;
+}
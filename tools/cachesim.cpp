@@ -0,0 +1,656 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Cache footprint of the table-driven backends, and a magic table layout
+// that keeps the hot entries together.
+//
+// Build with something like:
+//     g++ -O2 -o cachesim tools/cachesim.cpp
+//
+// Usage: cachesim [-f corpus] [-n queries] [-1 size,ways] [-2 size,ways] [-x noise] [-o layout.h]
+//
+// Each query (an occupancy, a square and a piece) is turned into the table
+// addresses the backend would read, the same way the backend works them
+// out, and those go through a two-level set-associative LRU cache model:
+// L1 (default 32K, 8 ways) sees every access and L2 (default 256K, 4 ways)
+// sees what L1 missed. Only the attack tables are modelled; the per-square
+// masks and magics are a few K and live in L1 anyway. -x adds that many
+// accesses per query to random lines of a 64MB region, standing in for
+// everything else a search touches, so the tables don't have the cache to
+// themselves.
+//
+// The corpus is read from a file with one query per line, "occupancy
+// square piece", occupancy in hex and piece b or r, or generated like
+// bench's "game" distribution. The report gives, per backend, the lines
+// of its tables that were touched at all, the hit rates, and L2 misses per
+// thousand queries.
+//
+// "magic-local" is Volker's magics with the sub-tables moved around so
+// that the entries queries actually hit share cache lines; see Repack().
+// The magics fix where the hot entries of a square fall within its
+// sub-table, and the table stays the size it was, so there isn't much room:
+// on the generated corpus it saves under 1% of the L2 misses (186.5 per
+// thousand queries against 187.2 with the default caches, 330.8 against
+// 331.8 with a 128K L2), and skewed, search-like corpora are where it has a
+// chance to do better. Entry heat comes from a separate training corpus (a
+// different seed, or the same file), so the numbers aren't flattered by
+// replaying the queries the layout was made from. -o writes that layout as
+// a header for magic.cpp, but only if it misses less than Volker's own:
+//     g++ -DBBATTACK_MAGICS='"layout.h"' ...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "../bbattack-private.h"
+#include "corpus.h"
+
+namespace Annuss {
+#include "../magic-annuss.h"
+}
+
+namespace BlackMagic {
+#include "../magic-black.h"
+}
+
+namespace {
+    enum Piece {
+        Bishop,
+        Rook
+    };
+
+    const char* const PieceName[2] = { "Bishop", "Rook" };
+
+    struct Query {
+        uint64_t occ;
+        uint8_t sq;
+        uint8_t piece;
+    };
+
+    constexpr int LineShift = 6;
+
+    // bench's "game" queries, each given a piece at random.
+    std::vector<Query> GenCorpus(uint64_t state, const int n)
+    {
+        std::vector<Query> queries(n);
+        uint64_t pieces = ~state;
+
+        Corpus::GenGame(state, queries.data(), n);
+
+        for (Query& q : queries) {
+            q.piece = Corpus::XorShift(pieces) & 1;
+        }
+
+        return queries;
+    }
+
+    bool ReadCorpus(const char* path, std::vector<Query>& queries)
+    {
+        FILE* in = fopen(path, "r");
+        unsigned long long occ;
+        unsigned int sq;
+        char piece;
+
+        if (in == nullptr) {
+            return false;
+        }
+
+        while (fscanf(in, "%llx %u %c", &occ, &sq, &piece) == 3) {
+            if (sq < 64 && (piece == 'b' || piece == 'r')) {
+                queries.push_back({ occ, (uint8_t)sq, (uint8_t)(piece == 'b' ? Bishop : Rook) });
+            }
+        }
+
+        fclose(in);
+
+        return !queries.empty();
+    }
+
+    uint64_t Mask(const int piece, const unsigned int sq)
+    {
+        return piece == Bishop ? CalcBishopMask(sq) : CalcRookMask(sq);
+    }
+
+    uint64_t Attacks(const int piece, const unsigned int sq, const uint64_t occ)
+    {
+        return piece == Bishop ? CalcBishopAttacks(sq, occ) : CalcRookAttacks(sq, occ);
+    }
+
+    // A magic layout: Volker's magics and shifts, and offsets that may or
+    // may not be his.
+    struct MagicLayout {
+        unsigned int offset[2][64];
+        size_t size;
+    };
+
+    unsigned int MagicIndex(const Query& q)
+    {
+        return q.piece == Bishop ?
+            ((q.occ & CalcBishopMask(q.sq)) * Annuss::BishopMagic[q.sq]) >> Annuss::BishopShift :
+            ((q.occ & CalcRookMask(q.sq)) * Annuss::RookMagic[q.sq]) >> Annuss::RookShift;
+    }
+
+    // Table addresses for one query, as byte offsets from a per-backend
+    // base; different tables of one backend sit at different bases.
+    typedef std::function<void(const Query&, std::vector<uint64_t>&)> Model;
+
+    uint64_t SoftPext(uint64_t x, uint64_t mask)
+    {
+        uint64_t result = 0;
+
+        for (uint64_t bit = 1; mask; bit <<= 1) {
+            if (x & mask & -mask) {
+                result |= bit;
+            }
+
+            mask &= mask - 1;
+        }
+
+        return result;
+    }
+
+    constexpr uint64_t SecondTable = 1ULL << 32;
+
+    Model MagicModel(const MagicLayout& layout)
+    {
+        return [layout](const Query& q, std::vector<uint64_t>& out) {
+            out.push_back(8ULL * (layout.offset[q.piece][q.sq] + MagicIndex(q)));
+        };
+    }
+
+    void BlackMagicModel(const Query& q, std::vector<uint64_t>& out)
+    {
+        const uint64_t key = q.occ | ~Mask(q.piece, q.sq);
+
+        out.push_back(8ULL * (q.piece == Bishop ?
+            BlackMagic::BishopOffset[q.sq] + ((key * BlackMagic::BishopMagic[q.sq]) >> BlackMagic::BishopShift) :
+            BlackMagic::RookOffset[q.sq] + ((key * BlackMagic::RookMagic[q.sq]) >> BlackMagic::RookShift)));
+    }
+
+    // The dedup pool numbers each square's attack sets with SetId(), one
+    // run per square, bishops first; see magic.cpp.
+    unsigned int PoolBase[2][64];
+
+    void InitPool()
+    {
+        unsigned int pool = 0;
+
+        for (unsigned int sq = 0; sq < 64; sq++) {
+            PoolBase[Bishop][sq] = pool;
+            pool += BishopSetCount(sq);
+        }
+
+        for (unsigned int sq = 0; sq < 64; sq++) {
+            PoolBase[Rook][sq] = pool;
+            pool += RookSetCount(sq);
+        }
+    }
+
+    void DedupModel(const Query& q, std::vector<uint64_t>& out)
+    {
+        const uint64_t attacks = Attacks(q.piece, q.sq, q.occ & Mask(q.piece, q.sq));
+        const unsigned int offset = q.piece == Bishop ? Annuss::BishopOffset[q.sq] : Annuss::RookOffset[q.sq];
+        const unsigned int id = q.piece == Bishop ? BishopSetId(q.sq, attacks) : RookSetId(q.sq, attacks);
+
+        out.push_back(2ULL * (offset + MagicIndex(q)));
+        out.push_back(SecondTable + 8ULL * (PoolBase[q.piece][q.sq] + id));
+    }
+
+    unsigned int PextOffset[2][64];
+
+    void InitPext()
+    {
+        unsigned int offset = 0;
+
+        for (int piece = Bishop; piece <= Rook; piece++) {
+            for (unsigned int sq = 0; sq < 64; sq++) {
+                PextOffset[piece][sq] = offset;
+                offset += 1U << __builtin_popcountll(Mask(piece, sq));
+            }
+        }
+    }
+
+    void PextModel(const Query& q, std::vector<uint64_t>& out)
+    {
+        out.push_back(8ULL * (PextOffset[q.piece][q.sq] + SoftPext(q.occ, Mask(q.piece, q.sq))));
+    }
+
+    void PextPdepModel(const Query& q, std::vector<uint64_t>& out)
+    {
+        out.push_back(2ULL * (PextOffset[q.piece][q.sq] + SoftPext(q.occ, Mask(q.piece, q.sq))));
+    }
+
+    // FillUp[64][8] first, then AFileAttacks[64][8]; see kindergarten.cpp.
+    void KindergartenModel(const Query& q, std::vector<uint64_t>& out)
+    {
+        const unsigned int file = q.sq & 7;
+        const uint64_t bfile = 0x0202020202020202ULL;
+
+        if (q.piece == Bishop) {
+            const uint64_t diag = GenMask<Northeast, false>(q.sq) | GenMask<Southwest, false>(q.sq);
+            const uint64_t anti = GenMask<Northwest, false>(q.sq) | GenMask<Southeast, false>(q.sq);
+
+            out.push_back(8ULL * (((((q.occ & diag) * bfile) >> 58) * 8) + file));
+            out.push_back(8ULL * (((((q.occ & anti) * bfile) >> 58) * 8) + file));
+        } else {
+            const uint64_t index = (((q.occ >> file) & 0x0101010101010101ULL) * 0x0080402010080400ULL) >> 58;
+
+            out.push_back(8ULL * ((((q.occ >> ((q.sq & 56) + 1)) & 63) * 8) + file));
+            out.push_back(4096 + 8ULL * (index * 8 + (q.sq >> 3)));
+        }
+    }
+
+    struct Cache {
+        unsigned int sets;
+        unsigned int ways;
+        std::vector<uint64_t> tag;
+        std::vector<uint64_t> used;
+        uint64_t clock = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        Cache(const size_t size, const unsigned int w) :
+            sets(std::max<size_t>(size >> LineShift, w) / w), ways(w), tag(sets * w, ~0ULL), used(sets * w, 0)
+        {
+        }
+
+        bool Access(const uint64_t line)
+        {
+            uint64_t* const t = &tag[(line % sets) * ways];
+            uint64_t* const u = &used[(line % sets) * ways];
+            unsigned int victim = 0;
+
+            clock++;
+
+            for (unsigned int i = 0; i < ways; i++) {
+                if (t[i] == line) {
+                    u[i] = clock;
+                    hits++;
+                    return true;
+                }
+
+                if (u[i] < u[victim]) {
+                    victim = i;
+                }
+            }
+
+            t[victim] = line;
+            u[victim] = clock;
+            misses++;
+
+            return false;
+        }
+    };
+
+    struct Config {
+        size_t l1_size = 32 << 10;
+        unsigned int l1_ways = 8;
+        size_t l2_size = 256 << 10;
+        unsigned int l2_ways = 4;
+        int noise = 0;
+    };
+
+    // Returns the L2 misses.
+    uint64_t Simulate(const char* name, const Model& model, const std::vector<Query>& queries, const Config& config)
+    {
+        constexpr uint64_t NoiseBase = 1ULL << 40;
+        constexpr uint64_t NoiseLines = (64ULL << 20) >> LineShift;
+        Cache l1(config.l1_size, config.l1_ways), l2(config.l2_size, config.l2_ways);
+        std::vector<uint64_t> addresses;
+        std::vector<uint64_t> touched;
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        uint64_t accesses = 0;
+
+        // Once to warm up, once for real.
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                l1.hits = l1.misses = l2.hits = l2.misses = 0;
+                accesses = 0;
+            }
+
+            for (const Query& q : queries) {
+                addresses.clear();
+                model(q, addresses);
+
+                for (int i = 0; i < config.noise; i++) {
+                    addresses.push_back(NoiseBase + ((Corpus::XorShift(state) % NoiseLines) << LineShift));
+                }
+
+                for (const uint64_t address : addresses) {
+                    const uint64_t line = address >> LineShift;
+
+                    if (pass == 0 && address < NoiseBase) {
+                        touched.push_back(line);
+                    }
+
+                    accesses++;
+
+                    if (!l1.Access(line)) {
+                        l2.Access(line);
+                    }
+                }
+            }
+        }
+
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+        printf("%-14s %9zu %9.2f %9.2f %11.2f\n", name, touched.size(),
+            100.0 * l1.hits / accesses,
+            100.0 * l2.hits / std::max<uint64_t>(l1.misses, 1),
+            1000.0 * l2.misses / queries.size());
+
+        return l2.misses;
+    }
+
+    // Re-pack Volker's sub-tables for locality without growing the table.
+    // Sub-tables may overlap where one has a hole or both hold the same
+    // attack set, as in tools/magics.cpp. Starting from Volker's layout,
+    // each sub-table in turn, hottest first, is lifted out and put back at
+    // the offset within the original size where the most of its training
+    // hits land on lines the other sub-tables already make hot, so the hot
+    // entries of different squares share lines instead of each dragging in
+    // a line of its own. It stays where it was unless somewhere else is
+    // strictly better.
+    MagicLayout Repack(const std::vector<Query>& training)
+    {
+        struct SubTable {
+            std::vector<uint64_t> slots;
+            std::vector<unsigned int> used;
+            std::vector<uint64_t> hits;
+            uint64_t heat;
+        };
+
+        const size_t size = Annuss::MagicTableSize;
+        std::vector<SubTable> tables;
+        std::vector<uint64_t> value(size, 0);
+        std::vector<unsigned int> refs(size, 0);
+        std::vector<uint64_t> line_heat((size + 7) >> 3, 0);
+        std::vector<int> order;
+        MagicLayout layout;
+
+        std::copy(Annuss::BishopOffset, Annuss::BishopOffset + 64, layout.offset[Bishop]);
+        std::copy(Annuss::RookOffset, Annuss::RookOffset + 64, layout.offset[Rook]);
+        layout.size = size;
+
+        for (int piece = Bishop; piece <= Rook; piece++) {
+            for (unsigned int sq = 0; sq < 64; sq++) {
+                const uint64_t mask = Mask(piece, sq);
+                const size_t entries = piece == Bishop ? 1U << (64 - Annuss::BishopShift) : 1U << (64 - Annuss::RookShift);
+                SubTable t = { std::vector<uint64_t>(entries, 0), {}, std::vector<uint64_t>(entries, 0), 0 };
+                uint64_t b = 0;
+
+                do {
+                    t.slots[MagicIndex({ b, (uint8_t)sq, (uint8_t)piece })] = Attacks(piece, sq, b);
+                } while ((b = SNOOB(mask, b)));
+
+                for (unsigned int i = 0; i < entries; i++) {
+                    if (t.slots[i] != 0) {
+                        t.used.push_back(i);
+                    }
+                }
+
+                tables.push_back(t);
+            }
+        }
+
+        for (const Query& q : training) {
+            SubTable& t = tables[q.piece * 64 + q.sq];
+
+            t.hits[MagicIndex(q)]++;
+            t.heat++;
+        }
+
+        for (int i = 0; i < 128; i++) {
+            const SubTable& t = tables[i];
+            const unsigned int at = layout.offset[i / 64][i % 64];
+
+            for (const unsigned int j : t.used) {
+                value[at + j] = t.slots[j];
+                refs[at + j]++;
+                line_heat[(at + j) >> 3] += t.hits[j];
+            }
+
+            if (t.heat != 0) {
+                order.push_back(i);
+            }
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return tables[a].heat > tables[b].heat; });
+
+        for (const int i : order) {
+            const SubTable& t = tables[i];
+            unsigned int& offset = layout.offset[i / 64][i % 64];
+
+            for (const unsigned int j : t.used) {
+                refs[offset + j]--;
+                line_heat[(offset + j) >> 3] -= t.hits[j];
+            }
+
+            const auto score = [&](const size_t at) {
+                uint64_t sum = 0;
+
+                for (const unsigned int j : t.used) {
+                    if (t.hits[j] != 0 && line_heat[(at + j) >> 3] != 0) {
+                        sum += t.hits[j];
+                    }
+                }
+
+                return sum;
+            };
+
+            size_t best = offset;
+            uint64_t best_score = score(offset);
+
+            for (size_t at = 0; at + t.used.back() < size; at++) {
+                bool fits = true;
+
+                for (const unsigned int j : t.used) {
+                    if (refs[at + j] != 0 && value[at + j] != t.slots[j]) {
+                        fits = false;
+                        break;
+                    }
+                }
+
+                if (fits) {
+                    const uint64_t s = score(at);
+
+                    if (s > best_score) {
+                        best_score = s;
+                        best = at;
+                    }
+                }
+            }
+
+            offset = best;
+
+            for (const unsigned int j : t.used) {
+                value[offset + j] = t.slots[j];
+                refs[offset + j]++;
+                line_heat[(offset + j) >> 3] += t.hits[j];
+            }
+        }
+
+        return layout;
+    }
+
+    void PrintArray(FILE* out, const char* type, const char* name, const uint64_t* values, const bool hex)
+    {
+        fprintf(out, "static constexpr %s %s[64] = {\n", type, name);
+
+        for (int i = 0; i < 64; i++) {
+            if (i % 4 == 0) {
+                fputs("    ", out);
+            }
+
+            if (hex) {
+                fprintf(out, "0x%llxULL", (unsigned long long)values[i]);
+            } else {
+                fprintf(out, "%llu", (unsigned long long)values[i]);
+            }
+
+            fputs(i == 63 ? "\n" : (i % 4 == 3 ? ",\n" : ", "), out);
+        }
+
+        fputs("};\n\n", out);
+    }
+
+    bool WriteLayout(const char* path, const MagicLayout& layout)
+    {
+        FILE* out = fopen(path, "w");
+        uint64_t offsets[64];
+
+        if (out == nullptr) {
+            return false;
+        }
+
+        fprintf(out, "// Generated by tools/cachesim.cpp: Volker Annuss' magics, packed for\n");
+        fprintf(out, "// locality. %zu entries, %zu bytes.\n\n", layout.size, layout.size * sizeof(uint64_t));
+        fputs("#ifndef BBATTACK_MAGICS_H\n", out);
+        fputs("#define BBATTACK_MAGICS_H\n\n", out);
+        fprintf(out, "static constexpr unsigned int MagicTableSize = %zu;\n\n", layout.size);
+        fprintf(out, "static constexpr unsigned int BishopShift = %u;\n\n", Annuss::BishopShift);
+        fprintf(out, "static constexpr unsigned int RookShift = %u;\n\n", Annuss::RookShift);
+
+        PrintArray(out, "uint64_t", "BishopMagic", Annuss::BishopMagic, true);
+        std::copy(layout.offset[Bishop], layout.offset[Bishop] + 64, offsets);
+        PrintArray(out, "unsigned int", "BishopOffset", offsets, false);
+
+        PrintArray(out, "uint64_t", "RookMagic", Annuss::RookMagic, true);
+        std::copy(layout.offset[Rook], layout.offset[Rook] + 64, offsets);
+        PrintArray(out, "unsigned int", "RookOffset", offsets, false);
+
+        fputs("#endif // #ifndef BBATTACK_MAGICS_H\n", out);
+        fclose(out);
+
+        return true;
+    }
+
+    bool ParseCache(const char* arg, size_t& size, unsigned int& ways)
+    {
+        char* end;
+        const unsigned long kb = strtoul(arg, &end, 10);
+
+        if (*end == 'K' || *end == 'k') {
+            end++;
+        }
+
+        if (*end != ',' || kb == 0) {
+            return false;
+        }
+
+        size = (size_t)kb << 10;
+        ways = std::max(atoi(end + 1), 1);
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* corpus = nullptr;
+    const char* output = nullptr;
+    int n = 1 << 20;
+    Config config;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
+
+        if (strcmp(argv[i], "-f") == 0 && has_arg) {
+            corpus = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && has_arg) {
+            n = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "-1") == 0 && has_arg && ParseCache(argv[i + 1], config.l1_size, config.l1_ways)) {
+            i++;
+        } else if (strcmp(argv[i], "-2") == 0 && has_arg && ParseCache(argv[i + 1], config.l2_size, config.l2_ways)) {
+            i++;
+        } else if (strcmp(argv[i], "-x") == 0 && has_arg) {
+            config.noise = std::max(atoi(argv[++i]), 0);
+        } else if (strcmp(argv[i], "-o") == 0 && has_arg) {
+            output = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-f corpus] [-n queries] [-1 size,ways] [-2 size,ways] [-x noise] [-o layout.h]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Query> queries, training;
+
+    if (corpus != nullptr) {
+        if (!ReadCorpus(corpus, queries)) {
+            fprintf(stderr, "cachesim: can't read any queries from %s\n", corpus);
+            return EXIT_FAILURE;
+        }
+
+        training = queries;
+    } else {
+        queries = GenCorpus(0x2545F4914F6CDD1DULL, n);
+        training = GenCorpus(0x9E3779B97F4A7C15ULL, n);
+    }
+
+    InitPool();
+    InitPext();
+
+    MagicLayout annuss;
+
+    std::copy(Annuss::BishopOffset, Annuss::BishopOffset + 64, annuss.offset[Bishop]);
+    std::copy(Annuss::RookOffset, Annuss::RookOffset + 64, annuss.offset[Rook]);
+    annuss.size = Annuss::MagicTableSize;
+
+    const MagicLayout local = Repack(training);
+
+    printf("%zu queries, L1 %zuK %u-way, L2 %zuK %u-way, %d noise accesses per query\n",
+        queries.size(), config.l1_size >> 10, config.l1_ways, config.l2_size >> 10, config.l2_ways, config.noise);
+    printf("magic tables: %zu entries (%zuK)\n\n", annuss.size, annuss.size * 8 >> 10);
+    printf("%-14s %9s %9s %9s %11s\n", "backend", "lines", "L1 hit%", "L2 hit%", "L2 miss/kq");
+
+    const uint64_t misses = Simulate("magic", MagicModel(annuss), queries, config);
+    const uint64_t local_misses = Simulate("magic-local", MagicModel(local), queries, config);
+    Simulate("magic-dedup", DedupModel, queries, config);
+    Simulate("black-magic", BlackMagicModel, queries, config);
+    Simulate("pext", PextModel, queries, config);
+    Simulate("pext-pdep", PextPdepModel, queries, config);
+    Simulate("kindergarten", KindergartenModel, queries, config);
+
+    if (output == nullptr) {
+        return EXIT_SUCCESS;
+    }
+
+    if (local_misses >= misses) {
+        fprintf(stderr, "cachesim: not writing %s: magic-local doesn't miss less than magic\n", output);
+        return EXIT_FAILURE;
+    }
+
+    if (!WriteLayout(output, local)) {
+        fprintf(stderr, "cachesim: can't write %s\n", output);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BBATTACK_TOOLS_CORPUS_H
+#define BBATTACK_TOOLS_CORPUS_H
+
+#include <stdint.h>
+
+// The synthetic query corpus shared by tools/bench.cpp and
+// tools/cachesim.cpp, so the cache model sees the same games the benchmark
+// times.
+
+namespace Corpus {
+    inline uint64_t XorShift(uint64_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Pick a uniformly random set bit of a non-empty bitboard.
+    inline unsigned int RandomBit(uint64_t& state, uint64_t bb)
+    {
+        int n = XorShift(state) % __builtin_popcountll(bb);
+
+        while (n--) {
+            bb &= bb - 1;
+        }
+
+        return __builtin_ctzll(bb);
+    }
+
+    // A crude stand-in for a game corpus: start from the initial position,
+    // shuffle pieces onto empty squares and capture every so often, until
+    // only a handful are left. The result has the piece counts and the
+    // clustering on the home ranks that real games have early on. Fills in
+    // the occ and sq of each query, sq always being occupied.
+    template<typename Query>
+    void GenGame(uint64_t& state, Query* queries, const int n)
+    {
+        uint64_t occ = 0xFFFF00000000FFFFULL;
+        int ply = 0;
+
+        for (int i = 0; i < n; i++) {
+            queries[i].occ = occ;
+            queries[i].sq = RandomBit(state, occ);
+
+            const unsigned int from = RandomBit(state, occ);
+
+            if ((XorShift(state) & 7) == 0) {
+                occ &= ~(1ULL << from);
+            } else {
+                const unsigned int to = RandomBit(state, ~occ);
+                occ ^= (1ULL << from) | (1ULL << to);
+            }
+
+            if (++ply >= 200 || __builtin_popcountll(occ) <= 4) {
+                occ = 0xFFFF00000000FFFFULL;
+                ply = 0;
+            }
+        }
+    }
+}
+
+#endif // #ifndef BBATTACK_TOOLS_CORPUS_H
@@ -0,0 +1,579 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Magic number search for magic.cpp and black-magic.cpp.
+//
+// Build with something like:
+//     g++ -O2 -o magics tools/magics.cpp
+//
+// Usage: magics [-f | -v | -n] [-b budget] [-t seconds] [-s seed] [-w] > magics.h
+//        magics -u
+//
+// Fixed-shift mode (-f, the default) looks for magics in the style of
+// Volker Annuss': every square indexes 512 (bishop) or 4096 (rook) slots,
+// but good magics leave most of those slots unused, and the per-square
+// sub-tables are packed into one another wherever the holes and the shared
+// attack sets allow it.
+//
+// Variable-shift mode (-v) lets every square pick its own index width too,
+// from one bit fewer than its relevant occupancy bits up to the fixed-shift
+// width, and packs the sub-tables the same way.
+//
+// Black magic mode (-n) is fixed-shift, but multiplies occ | ~mask rather
+// than occ & mask, for black-magic.cpp.
+//
+// The first two modes start from Volker's set, which took a great deal of
+// searching, so they never do worse than its 89524 entries; black magic mode
+// starts from the published black magics in magic-black.h (87988). Don't expect much better
+// either: his layout is 83% full, and its last 1024 entries are one dense
+// rook sub-table that has to find a home lower down before anything
+// shrinks. A ten-minute variable-shift run hasn't managed it, so give it
+// hours rather than minutes, and don't count on it.
+//
+// The search keeps going until the packed table fits into budget bytes (a
+// K or M suffix is understood) or the time runs out, and then prints the
+// best layout it found as a header; build the library with
+// -DBBATTACK_MAGICS='"magics.h"' to use it in magic.cpp. A variable-shift
+// header also wants -DBBATTACK_MAGIC_BISHOP_SHIFT=0 and
+// -DBBATTACK_MAGIC_ROOK_SHIFT=0, for the library and for anything using
+// BBATTACK_INLINE. If a budget was given and not met, it prints nothing and
+// fails instead. With -w the header carries magic.cpp's tables too, ready
+// made, which saves the compiler building them; magic-annuss-tables.h is
+// Volker's set written out by "magics -t 0 -w". Black magic headers are
+// only any use with -w, and replace magic-black-tables.h, which is
+// "magics -n -t 0 -w".
+//
+// -u doesn't search at all: it prints how many distinct attack sets each
+// square has, which is what the pool in magic.cpp's "magic-dedup" holds,
+// and how many of them turn up on more than one square.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../bbattack-private.h"
+
+namespace Annuss {
+#include "../magic-annuss.h"
+}
+
+namespace BlackMagics {
+#include "../magic-black.h"
+}
+
+namespace {
+    enum Piece {
+        Bishop,
+        Rook
+    };
+
+    enum Mode {
+        Fixed,
+        Variable,
+        Black
+    };
+
+    const char* const PieceName[2] = { "Bishop", "Rook" };
+
+    // Index bits for fixed-shift mode: shifts of 55 and 52.
+    constexpr int FixedBits[2] = { 9, 12 };
+
+    // Every relevant occupancy of a square along with its attack set. The
+    // key is what gets multiplied by the magic.
+    struct Square {
+        Piece piece;
+        unsigned int sq;
+        uint64_t mask;
+        std::vector<uint64_t> key;
+        std::vector<uint64_t> attacks;
+    };
+
+    // A magic for one square and the sub-table it gives: one slot per index,
+    // zero meaning unused, which is safe because no slider ever has an empty
+    // attack set.
+    struct Candidate {
+        uint64_t magic;
+        int bits;
+        std::vector<uint64_t> slots;
+        std::vector<unsigned int> used;
+    };
+
+    uint64_t State = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t XorShift()
+    {
+        State ^= State << 13;
+        State ^= State >> 7;
+        State ^= State << 17;
+        return State;
+    }
+
+    // Magics with few bits set tend to work best; black magics tend to be
+    // the other way round.
+    uint64_t Sparse(const Mode mode)
+    {
+        const uint64_t magic = XorShift() & XorShift() & XorShift();
+        return mode == Black ? ~magic : magic;
+    }
+
+    Square MakeSquare(const Piece piece, const unsigned int sq, const Mode mode)
+    {
+        Square s;
+        uint64_t b = 0;
+
+        s.piece = piece;
+        s.sq = sq;
+        s.mask = piece == Bishop ? CalcBishopMask(sq) : CalcRookMask(sq);
+
+        do {
+            s.key.push_back(mode == Black ? b | ~s.mask : b);
+            s.attacks.push_back(piece == Bishop ? CalcBishopAttacks(sq, b) : CalcRookAttacks(sq, b));
+        } while ((b = SNOOB(s.mask, b)));
+
+        return s;
+    }
+
+    // Work out the sub-table for a magic, or return false if two occupancies
+    // with different attacks collide.
+    bool Try(const Square& s, const uint64_t magic, const int bits, Candidate& c)
+    {
+        c.magic = magic;
+        c.bits = bits;
+        c.slots.assign(1ULL << bits, 0);
+        c.used.clear();
+
+        for (size_t i = 0; i < s.key.size(); i++) {
+            const size_t index = (s.key[i] * magic) >> (64 - bits);
+            uint64_t& slot = c.slots[index];
+
+            if (slot != 0 && slot != s.attacks[i]) {
+                return false;
+            }
+
+            slot = s.attacks[i];
+        }
+
+        for (size_t i = 0; i < c.slots.size(); i++) {
+            if (c.slots[i] != 0) {
+                c.used.push_back(i);
+            }
+        }
+
+        return true;
+    }
+
+    // The shared attack table. Sub-tables may overlap wherever one has a
+    // hole or both agree on the attack set, so every slot keeps count of
+    // how many squares use it.
+    struct Layout {
+        std::vector<uint64_t> value;
+        std::vector<unsigned int> refs;
+        std::vector<unsigned int> offset;
+        size_t size = 0;
+
+        bool Fits(const Candidate& c, const size_t at) const
+        {
+            for (unsigned int j : c.used) {
+                if (at + j < value.size() && refs[at + j] != 0 && value[at + j] != c.slots[j]) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        size_t FirstFit(const Candidate& c) const
+        {
+            size_t at = 0;
+
+            while (!Fits(c, at)) {
+                at++;
+            }
+
+            return at;
+        }
+
+        void Place(const Candidate& c, const size_t square, const size_t at)
+        {
+            if (at + c.used.back() >= value.size()) {
+                value.resize(at + c.used.back() + 1, 0);
+                refs.resize(at + c.used.back() + 1, 0);
+            }
+
+            for (unsigned int j : c.used) {
+                value[at + j] = c.slots[j];
+                refs[at + j]++;
+            }
+
+            offset[square] = at;
+            size = std::max(size, at + c.used.back() + 1);
+        }
+
+        void Remove(const Candidate& c, const size_t square)
+        {
+            for (unsigned int j : c.used) {
+                refs[offset[square] + j]--;
+            }
+
+            while (size > 0 && refs[size - 1] == 0) {
+                size--;
+            }
+        }
+    };
+
+    size_t ParseSize(const char* arg)
+    {
+        char* end;
+        size_t size = strtoull(arg, &end, 10);
+
+        if (*end == 'K' || *end == 'k') {
+            size <<= 10;
+        } else if (*end == 'M' || *end == 'm') {
+            size <<= 20;
+        }
+
+        return size;
+    }
+
+    void PrintArray(const char* type, const char* name, const std::vector<uint64_t>& values, const bool hex)
+    {
+        printf("static constexpr %s %s[64] = {\n", type, name);
+
+        for (int i = 0; i < 64; i++) {
+            if (i % 4 == 0) {
+                printf("    ");
+            }
+
+            if (hex) {
+                printf("0x%llxULL", (unsigned long long)values[i]);
+            } else {
+                printf("%llu", (unsigned long long)values[i]);
+            }
+
+            printf(i == 63 ? "\n" : (i % 4 == 3 ? ",\n" : ", "));
+        }
+
+        puts("};\n");
+    }
+}
+
+// The attack table and, for magic.cpp, magic-dedup's id table and pool, as
+// the library would build them; unused slots are zero.
+void PrintTables(const std::vector<Square>& squares, const std::vector<Candidate>& best, const Layout& layout, const bool dedup)
+{
+    std::vector<uint64_t> attacks(layout.size, 0);
+    std::vector<unsigned int> ids(layout.size, 0);
+    std::vector<uint64_t> pool(SetPoolSize(), 0);
+    unsigned int base = 0;
+
+    for (size_t i = 0; i < squares.size(); i++) {
+        const Square& s = squares[i];
+
+        for (size_t k = 0; k < s.key.size(); k++) {
+            const size_t index = layout.offset[i] + ((s.key[k] * best[i].magic) >> (64 - best[i].bits));
+            const unsigned int id = base + (s.piece == Bishop ? BishopSetId(s.sq, s.attacks[k]) : RookSetId(s.sq, s.attacks[k]));
+
+            attacks[index] = s.attacks[k];
+            ids[index] = id;
+            pool[id] = s.attacks[k];
+        }
+
+        base += s.piece == Bishop ? BishopSetCount(s.sq) : RookSetCount(s.sq);
+    }
+
+    puts("#define BBATTACK_MAGICS_TABLES\n");
+
+    puts("alignas(64) static constexpr uint64_t MagicAttacks[MagicTableSize] = {");
+
+    for (size_t i = 0; i < attacks.size(); i++) {
+        printf("%s0x%llxULL%s", i % 4 == 0 ? "    " : "", (unsigned long long)attacks[i],
+            i + 1 == attacks.size() ? "\n" : (i % 4 == 3 ? ",\n" : ", "));
+    }
+
+    puts("};\n");
+
+    if (!dedup) {
+        return;
+    }
+
+    puts("alignas(64) static constexpr uint16_t MagicSetIds[MagicTableSize] = {");
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        printf("%s%u%s", i % 16 == 0 ? "    " : "", ids[i],
+            i + 1 == ids.size() ? "\n" : (i % 16 == 15 ? ",\n" : ", "));
+    }
+
+    puts("};\n");
+
+    printf("alignas(64) static constexpr uint64_t MagicSetPool[%zu] = {\n", pool.size());
+
+    for (size_t i = 0; i < pool.size(); i++) {
+        printf("%s0x%llxULL%s", i % 4 == 0 ? "    " : "", (unsigned long long)pool[i],
+            i + 1 == pool.size() ? "\n" : (i % 4 == 3 ? ",\n" : ", "));
+    }
+
+    puts("};\n");
+}
+
+// Distinct attack sets per square, for both pieces, as two boards.
+void Report(const std::vector<Square>& squares)
+{
+    std::vector<uint64_t> all;
+    size_t total[2] = {0, 0};
+
+    for (const Square& s : squares) {
+        std::vector<uint64_t> sets(s.attacks);
+
+        std::sort(sets.begin(), sets.end());
+        sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+
+        printf("%5zu%s", sets.size(), s.sq % 8 == 7 ? "\n" : " ");
+
+        if (s.sq == 63) {
+            puts("");
+        }
+
+        total[s.piece] += sets.size();
+        all.insert(all.end(), sets.begin(), sets.end());
+    }
+
+    const size_t sum = all.size();
+
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+
+    printf("bishop: %zu sets, rook: %zu sets, %zu of them on more than one square (%zu distinct)\n",
+        total[Bishop], total[Rook], sum - all.size(), all.size());
+}
+
+int main(int argc, char** argv)
+{
+    Mode mode = Fixed;
+    size_t budget = 0;
+    double seconds = 10.0;
+    bool report = false;
+    bool tables = false;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
+
+        if (strcmp(argv[i], "-f") == 0) {
+            mode = Fixed;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            mode = Variable;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            mode = Black;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            tables = true;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            report = true;
+        } else if (strcmp(argv[i], "-b") == 0 && has_arg) {
+            budget = ParseSize(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && has_arg) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && has_arg) {
+            State = strtoull(argv[++i], nullptr, 0) | 1;
+        } else {
+            fprintf(stderr, "usage: %s [-f | -v | -n] [-b budget] [-t seconds] [-s seed] [-w] > magics.h\n", argv[0]);
+            fprintf(stderr, "       %s -u\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Square> squares;
+    std::vector<Candidate> best(128);
+    Layout layout;
+
+    for (unsigned int sq = 0; sq < 64; sq++) {
+        squares.push_back(MakeSquare(Bishop, sq, mode));
+    }
+
+    for (unsigned int sq = 0; sq < 64; sq++) {
+        squares.push_back(MakeSquare(Rook, sq, mode));
+    }
+
+    if (report) {
+        Report(squares);
+        return EXIT_SUCCESS;
+    }
+
+    layout.offset.assign(squares.size(), 0);
+
+    const clock_t start = clock();
+
+    // Start from Volker's magics and layout, whose shifts are one
+    // variable-shift choice among others, or from the published black
+    // magics.
+    for (size_t i = 0; i < squares.size(); i++) {
+        const Square& s = squares[i];
+        const bool black = mode == Black;
+        const uint64_t magic = s.piece == Bishop ?
+            (black ? BlackMagics::BishopMagic[s.sq] : Annuss::BishopMagic[s.sq]) :
+            (black ? BlackMagics::RookMagic[s.sq] : Annuss::RookMagic[s.sq]);
+        const unsigned int at = s.piece == Bishop ?
+            (black ? BlackMagics::BishopOffset[s.sq] : Annuss::BishopOffset[s.sq]) :
+            (black ? BlackMagics::RookOffset[s.sq] : Annuss::RookOffset[s.sq]);
+
+        if (!Try(s, magic, FixedBits[s.piece], best[i]) || !layout.Fits(best[i], at)) {
+            fprintf(stderr, "error: %s doesn't hold together at %s %u\n",
+                black ? "magic-black.h" : "magic-annuss.h", PieceName[s.piece], s.sq);
+            return EXIT_FAILURE;
+        }
+
+        layout.Place(best[i], i, at);
+    }
+
+    fprintf(stderr, "start: %zu entries (%zu bytes)\n", layout.size, layout.size * sizeof(uint64_t));
+
+    // Then pack by ruin and recreate: take out the sub-table that ends the
+    // table along with a few others, put them back biggest first wherever
+    // they first fit, and keep the result unless the table grew. Sideways
+    // moves are kept too, since they shuffle the holes for the next round.
+    // Now and then a square taken out gets a fresh magic; in variable-shift
+    // mode its index bits are picked anew as well, from one fewer than its
+    // relevant occupancy bits up to the fixed-shift width, because a wide
+    // but sparse sub-table often slots into holes where a dense one can't.
+    size_t round = 0;
+    std::vector<size_t> group, taken;
+    std::vector<Candidate> old;
+    std::vector<size_t> old_offset;
+    Candidate c;
+
+    while (layout.size * sizeof(uint64_t) > budget && (double)(clock() - start) / CLOCKS_PER_SEC < seconds) {
+        const size_t old_size = layout.size;
+
+        round++;
+        group.clear();
+
+        for (size_t j = 0; j < squares.size(); j++) {
+            if (layout.offset[j] + best[j].used.back() + 1 == layout.size) {
+                group.push_back(j);
+                break;
+            }
+        }
+
+        for (int k = 1 + XorShift() % 4; k > 0; k--) {
+            const size_t j = XorShift() % squares.size();
+
+            if (std::find(group.begin(), group.end(), j) == group.end()) {
+                group.push_back(j);
+            }
+        }
+
+        taken = group;
+        old.clear();
+        old_offset.clear();
+
+        for (size_t j : group) {
+            old.push_back(best[j]);
+            old_offset.push_back(layout.offset[j]);
+            layout.Remove(best[j], j);
+
+            int bits = FixedBits[squares[j].piece];
+
+            if (mode == Variable) {
+                bits -= XorShift() % (bits - __builtin_popcountll(squares[j].mask) + 2);
+            }
+
+            if (XorShift() % 4 == 0 && Try(squares[j], Sparse(mode), bits, c)) {
+                best[j] = c;
+            }
+        }
+
+        std::sort(group.begin(), group.end(), [&](size_t x, size_t y) {
+            return best[x].used.size() > best[y].used.size();
+        });
+
+        for (size_t j : group) {
+            layout.Place(best[j], j, layout.FirstFit(best[j]));
+        }
+
+        if (layout.size < old_size) {
+            fprintf(stderr, "%zu: %zu entries (%zu bytes)\n", round, layout.size, layout.size * sizeof(uint64_t));
+        } else if (layout.size > old_size) {
+            for (size_t j : group) {
+                layout.Remove(best[j], j);
+            }
+
+            for (size_t k = 0; k < taken.size(); k++) {
+                best[taken[k]] = old[k];
+                layout.Place(best[taken[k]], taken[k], old_offset[k]);
+            }
+        }
+    }
+
+    // A header over the budget would only look like an answer.
+    if (budget != 0 && layout.size * sizeof(uint64_t) > budget) {
+        fprintf(stderr, "error: best table is %zu bytes, over the budget of %zu\n", layout.size * sizeof(uint64_t), budget);
+        return EXIT_FAILURE;
+    }
+
+    const char* const ModeName[3] = { "fixed-shift", "variable-shift", "black magic" };
+
+    printf("// Generated by tools/magics.cpp in %s mode: %zu entries, %zu bytes.\n\n",
+        ModeName[mode], layout.size, layout.size * sizeof(uint64_t));
+
+    puts("#ifndef BBATTACK_MAGICS_H");
+    puts("#define BBATTACK_MAGICS_H\n");
+
+    printf("static constexpr unsigned int MagicTableSize = %zu;\n\n", layout.size);
+
+    for (int piece = Bishop; piece <= Rook; piece++) {
+        std::vector<uint64_t> magics, offsets, shifts;
+        char name[32];
+
+        for (int sq = 0; sq < 64; sq++) {
+            magics.push_back(best[piece * 64 + sq].magic);
+            offsets.push_back(layout.offset[piece * 64 + sq]);
+            shifts.push_back(64 - best[piece * 64 + sq].bits);
+        }
+
+        if (mode != Variable) {
+            printf("static constexpr unsigned int %sShift = %d;\n\n", PieceName[piece], 64 - FixedBits[piece]);
+        } else {
+            snprintf(name, sizeof(name), "%sShift", PieceName[piece]);
+            PrintArray("unsigned int", name, shifts, false);
+        }
+
+        snprintf(name, sizeof(name), "%sMagic", PieceName[piece]);
+        PrintArray("uint64_t", name, magics, true);
+
+        snprintf(name, sizeof(name), "%sOffset", PieceName[piece]);
+        PrintArray("unsigned int", name, offsets, false);
+    }
+
+    if (tables) {
+        PrintTables(squares, best, layout, mode != Black);
+    }
+
+    puts("#endif // #ifndef BBATTACK_MAGICS_H");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,492 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Perft over a standard suite of positions, with every linked-in attack
+// generation system in turn, as an end-to-end benchmark: the sliding
+// lookups share the cache with everything else a move generator does.
+//
+// Build with something like:
+//     g++ -O2 -o perft tools/perft.cpp *.cpp
+//
+// Usage: perft [-b backend] [-d depth] [-v]
+//
+// The usual depths come to 16 million nodes, a fraction of a second per
+// backend; -d runs every position to the given depth instead (up to 6 is
+// checked), for steadier numbers. Node counts are checked against the
+// known ones, so a wrong answer from a backend shows up as a mismatch.
+// The move generator is legal and copy-make, uses BBPinned(),
+// BBCheckers() and BBEvasionMask() to stay legal, and counts the moves at
+// the last ply rather than making them.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "../bbattack.h"
+
+namespace {
+    enum Colour {
+        White,
+        Black
+    };
+
+    enum Piece {
+        Pawn,
+        Knight,
+        Bishop,
+        Rook,
+        Queen,
+        King,
+        PieceCount
+    };
+
+    enum Castling {
+        WhiteShort = 1,
+        WhiteLong = 2,
+        BlackShort = 4,
+        BlackLong = 8
+    };
+
+    constexpr int NoSquare = 64;
+
+    struct Position {
+        uint64_t pieces[2][PieceCount];
+        uint64_t colour[2];
+        uint64_t occ;
+        int side;
+        int ep;         // square a pawn may capture en passant on, or NoSquare
+        int castling;
+    };
+
+    struct Move {
+        uint8_t from;
+        uint8_t to;
+        uint8_t promotion;  // a Piece, or Pawn for none
+    };
+
+    uint64_t KnightAttacks[64];
+    uint64_t KingAttacks[64];
+    uint64_t PawnAttacks[2][64];
+
+    // Castling rights that survive a move from or to each square.
+    int CastlingKept[64];
+
+    uint64_t Step(const int sq, const int file_step, const int rank_step)
+    {
+        const int file = sq % 8 + file_step;
+        const int rank = sq / 8 + rank_step;
+
+        return (file >= 0 && file < 8 && rank >= 0 && rank < 8) ? 1ULL << (rank * 8 + file) : 0;
+    }
+
+    void InitTables()
+    {
+        for (int sq = 0; sq < 64; sq++) {
+            KnightAttacks[sq] = Step(sq, 1, 2) | Step(sq, 2, 1) | Step(sq, 2, -1) | Step(sq, 1, -2) |
+                Step(sq, -1, -2) | Step(sq, -2, -1) | Step(sq, -2, 1) | Step(sq, -1, 2);
+            KingAttacks[sq] = Step(sq, 0, 1) | Step(sq, 1, 1) | Step(sq, 1, 0) | Step(sq, 1, -1) |
+                Step(sq, 0, -1) | Step(sq, -1, -1) | Step(sq, -1, 0) | Step(sq, -1, 1);
+            PawnAttacks[White][sq] = Step(sq, -1, 1) | Step(sq, 1, 1);
+            PawnAttacks[Black][sq] = Step(sq, -1, -1) | Step(sq, 1, -1);
+            CastlingKept[sq] = WhiteShort | WhiteLong | BlackShort | BlackLong;
+        }
+
+        CastlingKept[0] &= ~WhiteLong;
+        CastlingKept[4] &= ~(WhiteShort | WhiteLong);
+        CastlingKept[7] &= ~WhiteShort;
+        CastlingKept[56] &= ~BlackLong;
+        CastlingKept[60] &= ~(BlackShort | BlackLong);
+        CastlingKept[63] &= ~BlackShort;
+    }
+
+    void Update(Position& pos)
+    {
+        pos.colour[White] = pos.colour[Black] = 0;
+
+        for (int piece = 0; piece < PieceCount; piece++) {
+            pos.colour[White] |= pos.pieces[White][piece];
+            pos.colour[Black] |= pos.pieces[Black][piece];
+        }
+
+        pos.occ = pos.colour[White] | pos.colour[Black];
+    }
+
+    // Only the fields perft needs; the move counters are ignored.
+    bool ParseFEN(const char* fen, Position& pos)
+    {
+        static const char Letters[] = "pnbrqk";
+        int rank = 7, file = 0;
+
+        memset(&pos, 0, sizeof(pos));
+
+        for (; *fen != ' '; fen++) {
+            if (*fen == '\0') {
+                return false;
+            } else if (*fen == '/') {
+                rank--;
+                file = 0;
+            } else if (*fen >= '1' && *fen <= '8') {
+                file += *fen - '0';
+            } else {
+                const char* letter = strchr(Letters, *fen | 32);
+
+                if (letter == nullptr || rank < 0 || file > 7) {
+                    return false;
+                }
+
+                pos.pieces[(*fen & 32) ? Black : White][letter - Letters] |= 1ULL << (rank * 8 + file);
+                file++;
+            }
+        }
+
+        fen++;
+        pos.side = *fen == 'b' ? Black : White;
+        fen += 2;
+
+        for (; *fen != ' ' && *fen != '\0'; fen++) {
+            switch (*fen) {
+            case 'K': pos.castling |= WhiteShort; break;
+            case 'Q': pos.castling |= WhiteLong; break;
+            case 'k': pos.castling |= BlackShort; break;
+            case 'q': pos.castling |= BlackLong; break;
+            default: break;
+            }
+        }
+
+        pos.ep = NoSquare;
+
+        if (*fen == ' ' && fen[1] >= 'a' && fen[1] <= 'h') {
+            pos.ep = (fen[2] - '1') * 8 + (fen[1] - 'a');
+        }
+
+        Update(pos);
+
+        return true;
+    }
+
+    Position Make(const Position& pos, const Move move)
+    {
+        const int us = pos.side, them = !us;
+        const uint64_t from = 1ULL << move.from;
+        const uint64_t to = 1ULL << move.to;
+        Position next = pos;
+        int piece = 0;
+
+        while (!(pos.pieces[us][piece] & from)) {
+            piece++;
+        }
+
+        for (int captured = 0; captured < PieceCount; captured++) {
+            next.pieces[them][captured] &= ~to;
+        }
+
+        next.pieces[us][piece] ^= from;
+        next.pieces[us][move.promotion != Pawn ? move.promotion : piece] |= to;
+
+        if (piece == Pawn && move.to == pos.ep) {
+            next.pieces[them][Pawn] &= ~(1ULL << (move.to ^ 8));
+        }
+
+        // Castling, as a king move of two squares; the rook comes along.
+        if (piece == King && (move.to - move.from == 2 || move.from - move.to == 2)) {
+            const int rook_from = move.to > move.from ? move.from + 3 : move.from - 4;
+            const int rook_to = (move.from + move.to) / 2;
+
+            next.pieces[us][Rook] ^= (1ULL << rook_from) | (1ULL << rook_to);
+        }
+
+        next.ep = (piece == Pawn && (move.to ^ move.from) == 16) ? (move.from + move.to) / 2 : NoSquare;
+        next.castling &= CastlingKept[move.from] & CastlingKept[move.to];
+        next.side = them;
+
+        Update(next);
+
+        return next;
+    }
+
+    bool Attacked(const Position& pos, const int sq, const uint64_t occ)
+    {
+        const int them = !pos.side;
+        const uint64_t rq = pos.pieces[them][Rook] | pos.pieces[them][Queen];
+        const uint64_t bq = pos.pieces[them][Bishop] | pos.pieces[them][Queen];
+
+        return (KnightAttacks[sq] & pos.pieces[them][Knight]) ||
+            (PawnAttacks[pos.side][sq] & pos.pieces[them][Pawn]) ||
+            (KingAttacks[sq] & pos.pieces[them][King]) ||
+            (BBAttackRook(occ, sq) & rq) ||
+            (BBAttackBishop(occ, sq) & bq);
+    }
+
+    Move* Add(Move* list, const int from, uint64_t targets, const Piece promotion = Pawn)
+    {
+        while (targets) {
+            *list++ = { (uint8_t)from, (uint8_t)__builtin_ctzll(targets), (uint8_t)promotion };
+            targets &= targets - 1;
+        }
+
+        return list;
+    }
+
+    // Pawn moves to the last rank come out as four promotions.
+    Move* AddPawn(Move* list, const int from, uint64_t targets)
+    {
+        const uint64_t last = 0xFF000000000000FFULL;
+
+        list = Add(list, from, targets & ~last);
+
+        for (int promotion = Knight; promotion <= Queen; promotion++) {
+            list = Add(list, from, targets & last, (Piece)promotion);
+        }
+
+        return list;
+    }
+
+    int Generate(const Position& pos, Move* const moves)
+    {
+        const int us = pos.side, them = !us;
+        const uint64_t own = pos.colour[us];
+        const uint64_t enemy = pos.colour[them];
+        const uint64_t occ = pos.occ;
+        const uint64_t enemy_rq = pos.pieces[them][Rook] | pos.pieces[them][Queen];
+        const uint64_t enemy_bq = pos.pieces[them][Bishop] | pos.pieces[them][Queen];
+        const int king = __builtin_ctzll(pos.pieces[us][King]);
+        const uint64_t checkers = BBCheckers(occ, king, enemy_rq, enemy_bq) |
+            (KnightAttacks[king] & pos.pieces[them][Knight]) |
+            (PawnAttacks[us][king] & pos.pieces[them][Pawn]);
+        Move* list = moves;
+        uint64_t bb;
+
+        // The king can't stay on a checking ray by stepping away along it.
+        for (bb = KingAttacks[king] & ~own; bb; bb &= bb - 1) {
+            const int to = __builtin_ctzll(bb);
+
+            if (!Attacked(pos, to, occ ^ (1ULL << king))) {
+                list = Add(list, king, 1ULL << to);
+            }
+        }
+
+        if (checkers & (checkers - 1)) {
+            return list - moves;
+        }
+
+        const uint64_t evasion = BBEvasionMask(king, checkers);
+        const uint64_t pinned = BBPinned(occ, king, own, enemy_rq, enemy_bq);
+        const uint64_t targets = ~own & evasion;
+
+        for (bb = pos.pieces[us][Knight] & ~pinned; bb; bb &= bb - 1) {
+            const int from = __builtin_ctzll(bb);
+            list = Add(list, from, KnightAttacks[from] & targets);
+        }
+
+        for (bb = pos.pieces[us][Bishop]; bb; bb &= bb - 1) {
+            const int from = __builtin_ctzll(bb);
+            const uint64_t line = (pinned >> from) & 1 ? BBLine(king, from) : ~0ULL;
+            list = Add(list, from, BBAttackBishop(occ, from) & targets & line);
+        }
+
+        for (bb = pos.pieces[us][Rook]; bb; bb &= bb - 1) {
+            const int from = __builtin_ctzll(bb);
+            const uint64_t line = (pinned >> from) & 1 ? BBLine(king, from) : ~0ULL;
+            list = Add(list, from, BBAttackRook(occ, from) & targets & line);
+        }
+
+        for (bb = pos.pieces[us][Queen]; bb; bb &= bb - 1) {
+            const int from = __builtin_ctzll(bb);
+            const uint64_t line = (pinned >> from) & 1 ? BBLine(king, from) : ~0ULL;
+            list = Add(list, from, BBAttackQueen(occ, from) & targets & line);
+        }
+
+        const int forward = us == White ? 8 : -8;
+        const uint64_t second = us == White ? 0x000000000000FF00ULL : 0x00FF000000000000ULL;
+
+        for (bb = pos.pieces[us][Pawn]; bb; bb &= bb - 1) {
+            const int from = __builtin_ctzll(bb);
+            const uint64_t line = (pinned >> from) & 1 ? BBLine(king, from) : ~0ULL;
+            uint64_t to = PawnAttacks[us][from] & enemy;
+            const uint64_t single = 1ULL << (from + forward);
+
+            if (!(occ & single)) {
+                to |= single;
+
+                if ((second >> from) & 1 && !(occ & (1ULL << (from + 2 * forward)))) {
+                    to |= 1ULL << (from + 2 * forward);
+                }
+            }
+
+            list = AddPawn(list, from, to & evasion & line);
+
+            // En passant takes a pawn off a square the move doesn't land
+            // on, which the masks above don't allow for; so look at the
+            // king's rays with both pawns gone and the capturing one moved.
+            if (pos.ep != NoSquare && (PawnAttacks[us][from] >> pos.ep) & 1) {
+                const int captured = pos.ep ^ 8;
+                const uint64_t after = occ ^ (1ULL << from) ^ (1ULL << captured) ^ (1ULL << pos.ep);
+                const uint64_t other_checkers = checkers & ~(1ULL << captured) & ~(enemy_rq | enemy_bq);
+
+                if (!other_checkers && !(BBAttackRook(after, king) & enemy_rq) && !(BBAttackBishop(after, king) & enemy_bq)) {
+                    list = Add(list, from, 1ULL << pos.ep);
+                }
+            }
+        }
+
+        // Castling: the rights say the rook is there; the king must not be
+        // in check or pass through it.
+        if (!checkers) {
+            const int base = us == White ? 0 : 56;
+            const int rights = us == White ? pos.castling : pos.castling >> 2;
+
+            if ((rights & WhiteShort) && !(occ & (0x60ULL << base)) &&
+                !Attacked(pos, base + 5, occ) && !Attacked(pos, base + 6, occ)) {
+                list = Add(list, king, 1ULL << (base + 6));
+            }
+
+            if ((rights & WhiteLong) && !(occ & (0x0EULL << base)) &&
+                !Attacked(pos, base + 3, occ) && !Attacked(pos, base + 2, occ)) {
+                list = Add(list, king, 1ULL << (base + 2));
+            }
+        }
+
+        return list - moves;
+    }
+
+    uint64_t Perft(const Position& pos, const int depth)
+    {
+        Move moves[256];
+        const int n = Generate(pos, moves);
+        uint64_t nodes = 0;
+
+        if (depth <= 1) {
+            return n;
+        }
+
+        for (int i = 0; i < n; i++) {
+            nodes += Perft(Make(pos, moves[i]), depth - 1);
+        }
+
+        return nodes;
+    }
+
+    // The usual suite from the Chess Programming Wiki, with the depth each
+    // is run to by default and the known counts.
+    struct Test {
+        const char* name;
+        const char* fen;
+        int depth;
+        uint64_t nodes[6];
+    };
+
+    const Test Suite[] = {
+        { "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5,
+            { 20, 400, 8902, 197281, 4865609, 119060324 } },
+        { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+            { 48, 2039, 97862, 4085603, 193690690, 8031647685 } },
+        { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5,
+            { 14, 191, 2812, 43238, 674624, 11030083 } },
+        { "position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+            { 6, 264, 9467, 422333, 15833292, 706045033 } },
+        { "position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4,
+            { 44, 1486, 62379, 2103487, 89941194, 3048196529 } },
+        { "position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4,
+            { 46, 2079, 89890, 3894594, 164075551, 6923051137 } },
+    };
+}
+
+int main(int argc, char** argv)
+{
+    const char* only_backend = nullptr;
+    int depth = 0;
+    bool verbose = false;
+    bool all_ok = true;
+
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
+
+        if (strcmp(argv[i], "-b") == 0 && has_arg) {
+            only_backend = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && has_arg) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            fprintf(stderr, "usage: %s [-b backend] [-d depth] [-v]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    InitTables();
+
+    printf("%-16s %12s %10s %10s  %s\n", "backend", "nodes", "seconds", "Mnps", "result");
+
+    for (unsigned int b = 0; BBAttackBackendName(b) != nullptr; b++) {
+        using Clock = std::chrono::steady_clock;
+        const char* name = BBAttackBackendName(b);
+        uint64_t total = 0;
+        double seconds = 0.0;
+        bool ok = true;
+
+        if (only_backend != nullptr && strcmp(only_backend, name) != 0) {
+            continue;
+        }
+
+        if (BBAttackSelect(name) != 0) {
+            printf("%-16s skipped, not supported on this CPU\n", name);
+            continue;
+        }
+
+        for (const Test& test : Suite) {
+            const int d = depth > 0 ? depth : test.depth;
+            Position pos;
+
+            if (!ParseFEN(test.fen, pos)) {
+                fprintf(stderr, "perft: bad FEN for %s\n", test.name);
+                return EXIT_FAILURE;
+            }
+
+            const Clock::time_point start = Clock::now();
+            const uint64_t nodes = Perft(pos, d);
+            const double s = std::chrono::duration<double>(Clock::now() - start).count();
+            const bool known = d >= 1 && d <= 6;
+            const bool right = !known || nodes == test.nodes[d - 1];
+
+            if (verbose) {
+                printf("  %-14s depth %d %12llu %10.3f %10.2f  %s\n", test.name, d, (unsigned long long)nodes, s,
+                    nodes / s / 1e6, !known ? "unknown" : right ? "ok" : "MISMATCH");
+            }
+
+            ok = ok && right;
+            total += nodes;
+            seconds += s;
+        }
+
+        printf("%-16s %12llu %10.3f %10.2f  %s\n", name, (unsigned long long)total, seconds,
+            total / seconds / 1e6, ok ? "ok" : "MISMATCH");
+
+        all_ok = all_ok && ok;
+    }
+
+    return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -22,179 +22,468 @@
  * SOFTWARE.
  */
 
+// Generator for the "switch" backend.
+//
+// Build with something like:
+//     g++ -O2 -o switch tools/switch.cpp
+//
+// Usage: switch [-t] [-o prefix [-s shards] [-c command] [-j jobs]]
+//
+// With no options, prints the whole backend as one translation unit, one
+// giant switch per square and piece:
+//     switch > switch.cpp
+//
+// That is very slow to compile, and all on one core. -o writes it as
+// prefix.cpp, holding the entry points, and prefix-0.cpp and up holding
+// the per-square functions, spread over shards files (default 8, at most
+// 128, which is one per square and piece) so that they come out about the
+// same size and can be compiled in parallel.
+//
+// -t emits tables instead of switches: each square gets a constexpr array
+// indexed by a minimal perfect hash of its relevant occupancy, a multiply
+// and shift found by the generator, which every compiler gets through in
+// seconds. The backend is still called "switch".
+//
+// -c compiles every file written with command (say, "g++ -O2 -I.
+// -DBBATTACK_SWITCH -c"), jobs at a time (default 1), and prints how long
+// each one took along with the total CPU and wall clock time. Each file is
+// compiled to its own name with .o in place of .cpp.
+
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "../bbattack-private.h"
 
-static uint64_t BishopMask[64];
-static uint64_t RookMask[64];
+namespace {
+    enum Piece {
+        Bishop,
+        Rook
+    };
 
-// Steffan Westcott's innovation.
-static uint64_t SNOOB(const uint64_t set, const uint64_t subset)
-{
-    return (subset - set) & set;
-}
+    const char* const PieceName[2] = { "Bishop", "Rook" };
 
-static uint64_t CalcRookMask(int sq)
-{
-    uint64_t result = 0;
-
-    result |= GenMask<North, true>(sq);
-    result |= GenMask<South, true>(sq);
-    result |= GenMask<East,  true>(sq);
-    result |= GenMask<West,  true>(sq);
-   
-    return result;
-}
+    enum Mode {
+        Switches,
+        Tables
+    };
 
-static uint64_t CalcBishopMask(int sq)
-{
-    uint64_t result = 0;
-    
-    result |= GenMask<Northeast, true>(sq);
-    result |= GenMask<Southeast, true>(sq);
-    result |= GenMask<Northwest, true>(sq);
-    result |= GenMask<Southwest, true>(sq);
-
-    return result;
-}
+    // A per-square function or table, and the shard it goes into.
+    struct Unit {
+        Piece piece;
+        int sq;
+        size_t cases;
+        int shard;
+        uint64_t magic;     // tables only
+    };
 
-// Likewise.
-static uint64_t CalcRookAttacks(int sq, uint64_t block)
-{
-    uint64_t result = 0ULL;
-    int rk = sq/8, fl = sq%8, r, f;
-    for (r = rk+1; r <= 7; r++) {
-        result |= (1ULL << (fl + r*8));
-        if(block & (1ULL << (fl + r*8))) {
-            break;
+    uint64_t Mask(const Piece piece, const int sq)
+    {
+        return piece == Bishop ? CalcBishopMask(sq) : CalcRookMask(sq);
+    }
+
+    uint64_t Attacks(const Piece piece, const int sq, const uint64_t occ)
+    {
+        return piece == Bishop ? CalcBishopAttacks(sq, occ) : CalcRookAttacks(sq, occ);
+    }
+
+    uint64_t State = 0x2545F4914F6CDD1DULL;
+
+    uint64_t XorShift()
+    {
+        State ^= State << 13;
+        State ^= State >> 7;
+        State ^= State << 17;
+        return State;
+    }
+
+    // A multiplier that sends the 2^n relevant occupancies of a square to
+    // 2^n different n-bit indices: a minimal perfect hash, the same thing
+    // as a fancy magic with no constructive collisions.
+    uint64_t FindHash(const uint64_t mask)
+    {
+        const int bits = __builtin_popcountll(mask);
+        std::vector<bool> used(1ULL << bits);
+
+        for (;;) {
+            const uint64_t magic = XorShift() & XorShift() & XorShift();
+            uint64_t b = 0;
+            bool perfect = true;
+
+            if (__builtin_popcountll((mask * magic) >> 56) < 6) {
+                continue;
+            }
+
+            std::fill(used.begin(), used.end(), false);
+
+            do {
+                const uint64_t index = (b * magic) >> (64 - bits);
+
+                if (used[index]) {
+                    perfect = false;
+                    break;
+                }
+
+                used[index] = true;
+            } while ((b = SNOOB(mask, b)));
+
+            if (perfect) {
+                return magic;
+            }
         }
     }
-    for (r = rk-1; r >= 0; r--) {
-        result |= (1ULL << (fl + r*8));
-        if(block & (1ULL << (fl + r*8))) {
-            break;
+
+    void EmitPrologue(FILE* out)
+    {
+        fputs("#include <stdint.h>\n", out);
+        fputs("#include \"bbattack.h\"\n", out);
+        fputs("#ifdef BBATTACK_SWITCH\n", out);
+        fputs("#include \"bbattack-private.h\"\n", out);
+        fputs("namespace Switch {\n", out);
+    }
+
+    void EmitSquare(FILE* out, const Mode mode, const Unit& unit)
+    {
+        const uint64_t mask = Mask(unit.piece, unit.sq);
+        uint64_t b = 0;
+
+        if (mode == Switches) {
+            fprintf(out, "uint64_t %s%d(const uint64_t occ) {\n", PieceName[unit.piece], unit.sq);
+            fprintf(out, "switch (occ & %lluULL) {\n", (unsigned long long)mask);
+
+            do {
+                fprintf(out, "case %lluULL: return %lluULL;\n", (unsigned long long)b, (unsigned long long)Attacks(unit.piece, unit.sq, b));
+            } while ((b = SNOOB(mask, b)));
+
+            fputs("default: __builtin_unreachable();\n", out);
+            fputs("}}\n", out);
+            return;
+        }
+
+        const int bits = __builtin_popcountll(mask);
+        std::vector<uint64_t> table(1ULL << bits);
+
+        do {
+            table[(b * unit.magic) >> (64 - bits)] = Attacks(unit.piece, unit.sq, b);
+        } while ((b = SNOOB(mask, b)));
+
+        fprintf(out, "extern constexpr uint64_t %sTable%d[%zu] = {\n", PieceName[unit.piece], unit.sq, table.size());
+
+        for (size_t i = 0; i < table.size(); i++) {
+            fprintf(out, "%lluULL%s", (unsigned long long)table[i], i % 8 == 7 ? ",\n" : ", ");
         }
+
+        fputs("};\n", out);
     }
-    for (f = fl+1; f <= 7; f++) {
-        result |= (1ULL << (f + rk*8));
-        if(block & (1ULL << (f + rk*8))) {
-            break;
+
+    // Everything after the lookups proper.
+    void EmitEpilogueEntry(FILE* out)
+    {
+        // X-rays from two lookups
+        fputs("uint64_t XrayBishop(const uint64_t occ, const uint64_t blockers, const unsigned int sq) { return Xray<Bishop>(occ, blockers, sq); }\n", out);
+        fputs("uint64_t XrayRook(const uint64_t occ, const uint64_t blockers, const unsigned int sq) { return Xray<Rook>(occ, blockers, sq); }\n", out);
+
+        // No-op init
+        fputs("void Init() {}\n", out);
+        fputs("}\n", out);
+
+        fputs("const Backend SwitchBackend = { \"switch\", Switch::Init, Switch::Bishop, Switch::Rook, Switch::Queen, Switch::XrayBishop, Switch::XrayRook, nullptr, nullptr, nullptr };\n", out);
+    }
+
+    // Per-square arrays for the table lookups, in the entry file so the
+    // compiler sees all of them in one place.
+    void EmitTableEntry(FILE* out, const bool declare, const std::vector<Unit>& units)
+    {
+        for (int piece = Bishop; piece <= Rook; piece++) {
+            const char* const name = PieceName[piece];
+
+            if (declare) {
+                for (int sq = 0; sq < 64; sq++) {
+                    fprintf(out, "extern const uint64_t %sTable%d[];\n", name, sq);
+                }
+            }
+
+            fprintf(out, "static const uint64_t* const %sTable[64] = {\n", name);
+
+            for (int sq = 0; sq < 64; sq++) {
+                fprintf(out, "%sTable%d%s", name, sq, sq % 8 == 7 ? ",\n" : ", ");
+            }
+
+            fprintf(out, "};\nstatic constexpr uint64_t %sMask[64] = {\n", name);
+
+            for (int sq = 0; sq < 64; sq++) {
+                fprintf(out, "%lluULL%s", (unsigned long long)Mask((Piece)piece, sq), sq % 4 == 3 ? ",\n" : ", ");
+            }
+
+            fprintf(out, "};\nstatic constexpr uint64_t %sHash[64] = {\n", name);
+
+            for (const Unit& unit : units) {
+                if (unit.piece == piece) {
+                    fprintf(out, "%lluULL%s", (unsigned long long)unit.magic, unit.sq % 4 == 3 ? ",\n" : ", ");
+                }
+            }
+
+            fprintf(out, "};\nstatic constexpr uint8_t %sShift[64] = {\n", name);
+
+            for (int sq = 0; sq < 64; sq++) {
+                fprintf(out, "%d%s", 64 - __builtin_popcountll(Mask((Piece)piece, sq)), sq % 8 == 7 ? ",\n" : ", ");
+            }
+
+            fputs("};\n", out);
+            fprintf(out, "static inline uint64_t %sIndex(const uint64_t occ, const unsigned int sq) { return ((occ & %sMask[sq]) * %sHash[sq]) >> %sShift[sq]; }\n",
+                name, name, name, name);
         }
+
+        fputs("uint64_t Bishop(const uint64_t occ, const unsigned int sq) { return BishopTable[sq][BishopIndex(occ, sq)]; }\n", out);
+        fputs("uint64_t Rook(const uint64_t occ, const unsigned int sq) { return RookTable[sq][RookIndex(occ, sq)]; }\n", out);
+        fputs("uint64_t Queen(const uint64_t occ, const unsigned int sq) { return BishopTable[sq][BishopIndex(occ, sq)] | RookTable[sq][RookIndex(occ, sq)]; }\n", out);
     }
-    for (f = fl-1; f >= 0; f--) {
-        result |= (1ULL << (f + rk*8));
-        if(block & (1ULL << (f + rk*8))) {
-            break;
+
+    // The entry points switch on the square and call the per-square
+    // functions, which are declared first if they live elsewhere. Tables
+    // are looked up straight from the entry points instead.
+    void EmitEntry(FILE* out, const Mode mode, const bool declare, const std::vector<Unit>& units)
+    {
+        int sq;
+
+        if (mode == Tables) {
+            EmitTableEntry(out, declare, units);
+            EmitEpilogueEntry(out);
+            return;
+        }
+
+        if (declare) {
+            for (sq = 0; sq < 64; sq++) {
+                fprintf(out, "uint64_t Bishop%d(const uint64_t occ);\n", sq);
+                fprintf(out, "uint64_t Rook%d(const uint64_t occ);\n", sq);
+            }
+        }
+
+        // Bishop entry point
+        fputs("uint64_t Bishop(const uint64_t occ, const unsigned int sq) {\n", out);
+        fputs("switch (sq) {\n", out);
+
+        for (sq = 0; sq < 64; sq++) {
+            fprintf(out, "case %d: return Bishop%d(occ);\n", sq, sq);
+        }
+
+        fputs("default: __builtin_unreachable();\n", out);
+        fputs("}}\n", out);
+
+        // Rook entry point
+        fputs("uint64_t Rook(const uint64_t occ, const unsigned int sq) {\n", out);
+        fputs("switch (sq) {\n", out);
+
+        for (sq = 0; sq < 64; sq++) {
+            fprintf(out, "case %d: return Rook%d(occ);\n", sq, sq);
         }
+
+        fputs("default: __builtin_unreachable();\n", out);
+        fputs("}}\n", out);
+
+        // Queen entry point: one switch on the square for both pieces
+        fputs("uint64_t Queen(const uint64_t occ, const unsigned int sq) {\n", out);
+        fputs("switch (sq) {\n", out);
+
+        for (sq = 0; sq < 64; sq++) {
+            fprintf(out, "case %d: return Bishop%d(occ) | Rook%d(occ);\n", sq, sq, sq);
+        }
+
+        fputs("default: __builtin_unreachable();\n", out);
+        fputs("}}\n", out);
+
+        EmitEpilogueEntry(out);
     }
-    return result;
-}
 
-// Likewise. At this point I'll be banned from all ICGA tournaments.
-// Such is the price of laziness.
-static uint64_t CalcBishopAttacks(int sq, uint64_t block)
-{
-    uint64_t result = 0ULL;
-    int rk = sq/8, fl = sq%8, r, f;
-    for(r = rk+1, f = fl+1; r <= 7 && f <= 7; r++, f++) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
+    void EmitEpilogue(FILE* out, const bool entry)
+    {
+        if (!entry) {
+            fputs("}\n", out);
         }
+
+        fputs("#endif\n", out);
     }
-    for(r = rk+1, f = fl-1; r <= 7 && f >= 0; r++, f--) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
+
+    // Biggest first, each into whichever shard has the fewest cases so
+    // far. Rooks have up to eight times as many cases as bishops, so
+    // dealing them out in order would leave some shards far behind.
+    void Shard(std::vector<Unit>& units, const int shards)
+    {
+        std::vector<size_t> load(shards, 0);
+        std::vector<Unit*> order;
+
+        for (Unit& unit : units) {
+            order.push_back(&unit);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [](const Unit* a, const Unit* b) { return a->cases > b->cases; });
+
+        for (Unit* unit : order) {
+            const int shard = std::min_element(load.begin(), load.end()) - load.begin();
+
+            unit->shard = shard;
+            load[shard] += unit->cases;
         }
     }
-    for(r = rk-1, f = fl+1; r >= 0 && f <= 7; r--, f++) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
+
+    FILE* Open(const std::string& path)
+    {
+        FILE* out = fopen(path.c_str(), "w");
+
+        if (out == nullptr) {
+            fprintf(stderr, "switch: can't write %s\n", path.c_str());
+            exit(EXIT_FAILURE);
         }
+
+        return out;
     }
-    for(r = rk-1, f = fl-1; r >= 0 && f >= 0; r--, f--) {
-        result |= (1ULL << (f + r*8));
-        if(block & (1ULL << (f + r * 8))) {
-            break;
+
+    // Compile each file with command, jobs at a time, and report.
+    bool Compile(const std::vector<std::string>& files, const char* command, const int jobs)
+    {
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> seconds(files.size());
+        std::atomic<size_t> next(0);
+        std::atomic<bool> ok(true);
+        std::vector<std::thread> threads;
+        const Clock::time_point start = Clock::now();
+
+        for (int i = 0; i < jobs; i++) {
+            threads.emplace_back([&] {
+                size_t n;
+
+                while ((n = next++) < files.size()) {
+                    const std::string object = files[n].substr(0, files[n].size() - 4) + ".o";
+                    const std::string cmd = std::string(command) + " " + files[n] + " -o " + object;
+                    const Clock::time_point t = Clock::now();
+
+                    if (system(cmd.c_str()) != 0) {
+                        fprintf(stderr, "switch: \"%s\" failed\n", cmd.c_str());
+                        ok = false;
+                    }
+
+                    seconds[n] = std::chrono::duration<double>(Clock::now() - t).count();
+                }
+            });
+        }
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        const double wall = std::chrono::duration<double>(Clock::now() - start).count();
+        double total = 0.0;
+
+        for (size_t n = 0; n < files.size(); n++) {
+            fprintf(stderr, "%-24s %8.2fs\n", files[n].c_str(), seconds[n]);
+            total += seconds[n];
         }
+
+        fprintf(stderr, "%zu files, %.2fs compiling, %.2fs wall clock with %d jobs\n", files.size(), total, wall, jobs);
+
+        return ok;
     }
-    return result;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    uint64_t b, *index;
-    int sq;
+    Mode mode = Switches;
+    const char* prefix = nullptr;
+    const char* command = nullptr;
+    int shards = 8;
+    int jobs = 1;
 
-    puts("#include <stdint.h>");
-    puts("#include \"bbattack.h\"");
-    puts("#ifdef USE_SWITCH");
+    for (int i = 1; i < argc; i++) {
+        const bool has_arg = i + 1 < argc;
 
-    // Bishop individual squares
-    for (sq = 0; sq < 64; sq++) {
-        printf("uint64_t Bishop%d(const uint64_t occ) {\n", sq);
+        if (strcmp(argv[i], "-t") == 0) {
+            mode = Tables;
+        } else if (strcmp(argv[i], "-o") == 0 && has_arg) {
+            prefix = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && has_arg) {
+            shards = std::min(std::max(atoi(argv[++i]), 1), 128);
+        } else if (strcmp(argv[i], "-c") == 0 && has_arg) {
+            command = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && has_arg) {
+            jobs = std::max(atoi(argv[++i]), 1);
+        } else {
+            fprintf(stderr, "usage: %s [-t] [-o prefix [-s shards] [-c command] [-j jobs]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-        b = 0;
-        BishopMask[sq] = CalcBishopMask(sq);
-        printf("switch (occ & %lluULL) {\n", BishopMask[sq]);
+    if (command != nullptr && prefix == nullptr) {
+        fprintf(stderr, "switch: -c needs -o\n");
+        return EXIT_FAILURE;
+    }
 
-        do {
-            printf("case %lluULL: return %lluULL;\n", b, CalcBishopAttacks(sq, b));
-        } while ((b = SNOOB(BishopMask[sq], b)));
-        
-        puts("default: __builtin_unreachable();");
+    std::vector<Unit> units;
 
-        puts("}}");
+    for (int piece = Bishop; piece <= Rook; piece++) {
+        for (int sq = 0; sq < 64; sq++) {
+            units.push_back({ (Piece)piece, sq, 1ULL << __builtin_popcountll(Mask((Piece)piece, sq)), 0, 0 });
+        }
     }
 
-    // Bishop entry point
-    puts("uint64_t BBAttackBishop(const uint64_t occ, const unsigned int sq) {");
-    puts("switch (sq) {");
-
-    for (sq = 0; sq < 64; sq++) {
-        printf("case %d: return Bishop%d(occ);\n", sq, sq);
+    if (mode == Tables) {
+        for (Unit& unit : units) {
+            unit.magic = FindHash(Mask(unit.piece, unit.sq));
+        }
     }
-    
-    puts("default: __builtin_unreachable();");
-    
-    puts("}}");
 
-    // Rook individual squares
-    for (sq = 0; sq < 64; sq++) {
-        printf("uint64_t Rook%d(const uint64_t occ) {\n", sq);
+    // Everything in one file, on stdout.
+    if (prefix == nullptr) {
+        EmitPrologue(stdout);
 
-        b = 0;
-        RookMask[sq] = CalcRookMask(sq);
-        printf("switch (occ & %lluULL) {\n", RookMask[sq]);
+        for (const Unit& unit : units) {
+            EmitSquare(stdout, mode, unit);
+        }
 
-        do {
-            printf("case %lluULL: return %lluULL;\n", b, CalcRookAttacks(sq, b));
-        } while ((b = SNOOB(RookMask[sq], b)));
+        EmitEntry(stdout, mode, false, units);
+        EmitEpilogue(stdout, true);
+
+        return EXIT_SUCCESS;
+    }
 
-        puts("default: __builtin_unreachable();");
+    std::vector<std::string> files;
+    std::vector<FILE*> out;
 
-        puts("}}");
+    Shard(units, shards);
+
+    files.push_back(std::string(prefix) + ".cpp");
+
+    for (int shard = 0; shard < shards; shard++) {
+        files.push_back(std::string(prefix) + "-" + std::to_string(shard) + ".cpp");
     }
 
-    // Rook entry point
-    puts("uint64_t BBAttackRook(const uint64_t occ, const unsigned int sq) {");
-    puts("switch (sq) {");
+    for (const std::string& file : files) {
+        out.push_back(Open(file));
+        EmitPrologue(out.back());
+    }
 
-    for (sq = 0; sq < 64; sq++) {
-        printf("case %d: return Rook%d(occ);\n", sq, sq);
+    for (const Unit& unit : units) {
+        EmitSquare(out[1 + unit.shard], mode, unit);
     }
-    
-    puts("default: __builtin_unreachable();");
 
-    puts("}}");
+    EmitEntry(out[0], mode, true, units);
 
-    // No-op init
-    puts("void BBAttackInit() {}");
+    for (size_t n = 0; n < out.size(); n++) {
+        EmitEpilogue(out[n], n == 0);
+        fclose(out[n]);
+    }
+
+    if (command != nullptr && !Compile(files, command, jobs)) {
+        return EXIT_FAILURE;
+    }
 
-    puts("#endif");
+    return EXIT_SUCCESS;
 }
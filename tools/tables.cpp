@@ -0,0 +1,65 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Dan Ravensloft
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Table file writer.
+//
+// Build with something like:
+//     g++ -O2 -I. -o tables tools/tables.cpp *.cpp
+//
+// Usage: tables backend file
+//
+// Builds the named backend's table ("magic", "black-magic" or "pext") and
+// saves it to file, which programs can then share with
+// BBAttackLoadTables(). Then loads it back, to be sure it will.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../bbattack.h"
+#include "../bbattack-private.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s backend file\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (BBAttackSelect(argv[1]) != 0) {
+        fprintf(stderr, "tables: no backend \"%s\" on this machine\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (WriteTableFile(argv[1], argv[2]) != 0) {
+        fprintf(stderr, "tables: couldn't write the %s table to %s\n", argv[1], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (BBAttackLoadTables(argv[2]) != 0) {
+        fprintf(stderr, "tables: %s doesn't load back\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}